@@ -0,0 +1,399 @@
+/**
+ * @brief: 性能基准：按场景和线程数测量日志调用的吞吐和单次调用延迟分位数，结果输出为 CSV 或 JSON
+ * 用法：dlog_bench [-t 1,2,4,...] [-n total] [-s scenario,...] [-f csv|json] [-o file] [-d dir]
+ *   -t  线程数列表，默认 1,2,4,8,16,32,64
+ *   -n  每轮的日志总条数（平均分给各线程），默认 100000
+ *   -s  只运行指定场景（逗号分隔），默认全部，-l 列出所有场景
+ *   -f  输出格式，默认 csv
+ *   -o  结果输出文件，默认标准输出
+ *   -d  工作目录，基准在其中生成 dlog.properties 和日志文件，默认 ./bench_run
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "../include/dlog.h"
+
+#ifndef DLOG_BENCH_VERSION
+#define DLOG_BENCH_VERSION "unknown"
+#endif
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_LONG_MESSAGE_SIZE 1024
+#define BENCH_ROTATE_SIZE "64M"
+
+/* 消息类型：prefix 在格式串中拼接调用点前缀（每次调用取进程号和线程号），site 使用静态调用点描述；
+ * typed 为与 short 内容相同的类型化调用，mixed 为多个整数、十六进制和浮点数的消息及其类型化版本 */
+enum {
+    BENCH_MSG_SHORT, BENCH_MSG_LONG, BENCH_MSG_PREFIX, BENCH_MSG_SITE,
+    BENCH_MSG_TYPED, BENCH_MSG_MIXED, BENCH_MSG_MIXED_TYPED
+};
+static const char* message_names[] = { "short", "long", "prefix", "site", "typed", "mixed", "mixed_typed" };
+
+/* 基准场景：每个场景对应 dlog.properties 中的一个模块 */
+struct bench_scenario {
+    const char* name;
+    const char* sink;       // log_type；FANOUT 表示同一实例写两个文件（sinks 配置）
+    const char* mode;       // sync | async
+    const char* overflow;
+    const char* level;      // 实例等级
+    log_level call_level;   // 调用时使用的等级，低于实例等级时测的是被过滤的调用
+    int message;
+};
+
+static const struct bench_scenario scenarios[] = {
+    { "filtered_debug",        "FILE",   "sync",  "block",         "INFO",  LOG_DEBUG, BENCH_MSG_SHORT },
+    { "none_sync",             "NONE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    { "none_async",            "NONE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    // NONE 输出只剩调用线程的格式化，对比 vsnprintf 与类型化格式化
+    { "none_sync_typed",       "NONE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_TYPED },
+    { "none_sync_mixed",       "NONE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_MIXED },
+    { "none_sync_mixed_typed", "NONE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_MIXED_TYPED },
+    { "screen_sync",           "SCREEN", "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    { "file_sync_short",       "FILE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    { "file_sync_long",        "FILE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_LONG },
+    { "file_async_short",      "FILE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    { "file_async_long",       "FILE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_LONG },
+    { "file_async_typed",      "FILE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_TYPED },
+    { "file_sync_prefix",      "FILE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_PREFIX },
+    { "file_sync_site",        "FILE",   "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SITE },
+    { "file_async_prefix",     "FILE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_PREFIX },
+    { "file_async_site",       "FILE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SITE },
+    // 一次格式化写两个文件，与 file_*_short 对比多输出端的额外开销
+    { "fanout_sync_short",     "FANOUT", "sync",  "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    { "fanout_async_short",    "FANOUT", "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_SHORT },
+    // 长消息 + 多线程使写出线程跟不上，观察缓冲池耗尽时各溢出策略的表现
+    { "exhaust_block",         "FILE",   "async", "block",         "DEBUG", LOG_INFO,  BENCH_MSG_LONG },
+    { "exhaust_drop_new",      "FILE",   "async", "drop_new",      "DEBUG", LOG_INFO,  BENCH_MSG_LONG },
+    { "exhaust_drop_oldest",   "FILE",   "async", "drop_oldest",   "DEBUG", LOG_INFO,  BENCH_MSG_LONG },
+    { "exhaust_sync_fallback", "FILE",   "async", "sync_fallback", "DEBUG", LOG_INFO,  BENCH_MSG_LONG },
+};
+#define SCENARIO_COUNT (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+struct bench_result {
+    const struct bench_scenario* scenario;
+    int threads;
+    uint64_t messages;
+    double seconds;
+    uint64_t p50_ns, p99_ns, p999_ns, max_ns;
+    uint64_t dropped;
+    uint64_t sync_fallbacks;
+};
+
+struct bench_thread {
+    pthread_t thread;
+    void* logger;
+    const struct bench_scenario* scenario;
+    uint64_t iterations;
+    uint32_t* latency_ns;   // 每次调用的耗时
+};
+
+static pthread_barrier_t start_barrier;
+static char long_message[BENCH_LONG_MESSAGE_SIZE];
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void* bench_thread_func(void* arg) {
+    struct bench_thread* t = (struct bench_thread*)arg;
+    log_level level = t->scenario->call_level;
+    int message = t->scenario->message;
+    static const struct dlog_site site = {
+        "bench", LOG_INFO, DLOG_FILENAME, __func__, __LINE__, "bench short message %llu value=%d"
+    };
+    pthread_barrier_wait(&start_barrier);
+    for (uint64_t i = 0; i < t->iterations; i++) {
+        uint64_t start = now_ns();
+        // 与 LOG_MODULE_MSG / LOG_SITE_MSG 相同的调用路径：先无锁判断等级，再格式化输出
+        if (log_level_enabled(t->logger, level)) {
+            switch (message) {
+                case BENCH_MSG_LONG:
+                    log_msg(t->logger, level, "bench long message %llu %s", (unsigned long long)i, long_message);
+                    break;
+                case BENCH_MSG_PREFIX:
+                    log_msg(t->logger, level, "<%d,%d,%s,%s,%d> bench short message %llu value=%d",
+                            (int)getpid(), (int)syscall(SYS_gettid), DLOG_FILENAME, __func__, __LINE__,
+                            (unsigned long long)i, (int)(i & 0xff));
+                    break;
+                case BENCH_MSG_SITE:
+                    log_site_msg(t->logger, &site, (unsigned long long)i, (int)(i & 0xff));
+                    break;
+                case BENCH_MSG_TYPED: {
+                    const struct dlog_value values[] = {
+                        DLOG_VALUES("bench short message ", (unsigned long long)i, " value=", (int)(i & 0xff))
+                    };
+                    log_typed_msg(t->logger, level, values, 4);
+                    break;
+                }
+                case BENCH_MSG_MIXED:
+                    log_msg(t->logger, level, "req=%llu status=%d bytes=%zu flags=0x%x cost=%.3fms peer=%s",
+                            (unsigned long long)i, (int)(i % 600), (size_t)(i * 37), (unsigned)(i & 0xffff),
+                            (double)(i % 1000) / 7.0, "10.0.0.1");
+                    break;
+                case BENCH_MSG_MIXED_TYPED: {
+                    const struct dlog_value values[] = {
+                        DLOG_VALUES("req=", (unsigned long long)i, " status=", (int)(i % 600),
+                                    " bytes=", (size_t)(i * 37), " flags=0x", DLOG_HEX(i & 0xffff),
+                                    " cost=", DLOG_FIXED((double)(i % 1000) / 7.0, 3), "ms peer=", "10.0.0.1")
+                    };
+                    log_typed_msg(t->logger, level, values, 12);
+                    break;
+                }
+                default:
+                    log_msg(t->logger, level, "bench short message %llu value=%d", (unsigned long long)i, (int)(i & 0xff));
+                    break;
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+        t->latency_ns[i] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    }
+    return NULL;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint32_t* sorted, uint64_t count, double p) {
+    uint64_t index = (uint64_t)(p / 100.0 * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static int bench_run(const struct bench_scenario* scenario, int threads, uint64_t total, struct bench_result* result) {
+    void* logger = log_module_init(scenario->name);
+    if (!logger) return -1;
+    uint64_t per_thread = total / (uint64_t)threads;
+    if (per_thread == 0) per_thread = 1;
+    uint64_t messages = per_thread * (uint64_t)threads;
+
+    struct bench_thread* workers = (struct bench_thread*)calloc((size_t)threads, sizeof(struct bench_thread));
+    uint32_t* samples = (uint32_t*)malloc(sizeof(uint32_t) * messages);
+    if (!workers || !samples) {
+        free(workers);
+        free(samples);
+        return -1;
+    }
+    struct dlog_stats before, after;
+    dlog_get_stats(logger, &before);
+
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)threads + 1);
+    int started = 0;
+    for (; started < threads; started++) {
+        struct bench_thread* t = &workers[started];
+        t->logger = logger;
+        t->scenario = scenario;
+        t->iterations = per_thread;
+        t->latency_ns = samples + per_thread * (uint64_t)started;
+        if (pthread_create(&t->thread, NULL, bench_thread_func, t) != 0) break;
+    }
+    if (started < threads) {
+        // 创建线程失败时已创建的线程仍在屏障处等待，无法干净退出
+        fprintf(stderr, "Error creating bench thread %d\n", started);
+        exit(1);
+    }
+    // 计时从放行所有线程之前开始，线程可能先于主线程从屏障返回
+    uint64_t start = now_ns();
+    pthread_barrier_wait(&start_barrier);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    // 吞吐包含异步队列写完并落盘的时间
+    log_flush();
+    uint64_t elapsed = now_ns() - start;
+    pthread_barrier_destroy(&start_barrier);
+    dlog_get_stats(logger, &after);
+
+    qsort(samples, messages, sizeof(uint32_t), compare_u32);
+    result->scenario = scenario;
+    result->threads = threads;
+    result->messages = messages;
+    result->seconds = (double)elapsed / 1e9;
+    result->p50_ns = percentile(samples, messages, 50);
+    result->p99_ns = percentile(samples, messages, 99);
+    result->p999_ns = percentile(samples, messages, 99.9);
+    result->max_ns = samples[messages - 1];
+    result->dropped = after.dropped - before.dropped;
+    result->sync_fallbacks = after.sync_fallbacks - before.sync_fallbacks;
+    free(workers);
+    free(samples);
+    return 0;
+}
+
+// 为所有场景生成配置；文件按大小滚动且只保留一个滚动文件，限制基准占用的磁盘空间
+static int write_config() {
+    FILE* file = fopen("dlog.properties", "w");
+    if (!file) return -1;
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        const struct bench_scenario* s = &scenarios[i];
+        fprintf(file, "logger.%s.log_level = %s\n", s->name, s->level);
+        if (strcmp(s->sink, "FANOUT") == 0) {
+            fprintf(file, "logger.%s.sinks = file:%s.log, file:%s_copy.log\n", s->name, s->name, s->name);
+        } else {
+            fprintf(file, "logger.%s.log_type = %s\n", s->name, s->sink);
+            fprintf(file, "logger.%s.log_file = %s.log\n", s->name, s->name);
+        }
+        fprintf(file, "logger.%s.mode = %s\n", s->name, s->mode);
+        fprintf(file, "logger.%s.overflow = %s\n", s->name, s->overflow);
+        fprintf(file, "logger.%s.rotate_size = %s\n", s->name, BENCH_ROTATE_SIZE);
+        fprintf(file, "logger.%s.max_files = 1\n", s->name);
+    }
+    return fclose(file);
+}
+
+static void print_header(FILE* out, int json) {
+    if (json) {
+        fprintf(out, "{\"version\": \"%s\", \"results\": [", DLOG_BENCH_VERSION);
+    } else {
+        fprintf(out, "version,scenario,sink,mode,overflow,message,threads,messages,seconds,msgs_per_sec,"
+                     "p50_ns,p99_ns,p999_ns,max_ns,dropped,sync_fallbacks\n");
+    }
+}
+
+static void print_result(FILE* out, int json, int first, const struct bench_result* r) {
+    const struct bench_scenario* s = r->scenario;
+    double rate = r->seconds > 0 ? (double)r->messages / r->seconds : 0;
+    const char* message = message_names[s->message];
+    if (json) {
+        fprintf(out, "%s\n  {\"scenario\": \"%s\", \"sink\": \"%s\", \"mode\": \"%s\", \"overflow\": \"%s\", "
+                     "\"message\": \"%s\", \"threads\": %d, \"messages\": %llu, \"seconds\": %.6f, "
+                     "\"msgs_per_sec\": %.0f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+                     "\"max_ns\": %llu, \"dropped\": %llu, \"sync_fallbacks\": %llu}",
+                first ? "" : ",", s->name, s->sink, s->mode, s->overflow, message, r->threads,
+                (unsigned long long)r->messages, r->seconds, rate,
+                (unsigned long long)r->p50_ns, (unsigned long long)r->p99_ns, (unsigned long long)r->p999_ns,
+                (unsigned long long)r->max_ns, (unsigned long long)r->dropped, (unsigned long long)r->sync_fallbacks);
+    } else {
+        fprintf(out, "%s,%s,%s,%s,%s,%s,%d,%llu,%.6f,%.0f,%llu,%llu,%llu,%llu,%llu,%llu\n",
+                DLOG_BENCH_VERSION, s->name, s->sink, s->mode, s->overflow, message, r->threads,
+                (unsigned long long)r->messages, r->seconds, rate,
+                (unsigned long long)r->p50_ns, (unsigned long long)r->p99_ns, (unsigned long long)r->p999_ns,
+                (unsigned long long)r->max_ns, (unsigned long long)r->dropped, (unsigned long long)r->sync_fallbacks);
+    }
+    fflush(out);
+}
+
+static int parse_threads(const char* value, int* threads, int max) {
+    int count = 0;
+    const char* p = value;
+    while (*p && count < max) {
+        char* end;
+        long n = strtol(p, &end, 10);
+        if (end == p || n < 1 || n > BENCH_MAX_THREADS) return -1;
+        threads[count++] = (int)n;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+static int scenario_selected(const char* filter, const char* name) {
+    if (!filter) return 1;
+    size_t len = strlen(name);
+    for (const char* p = filter; (p = strstr(p, name)) != NULL; p += len) {
+        if ((p == filter || p[-1] == ',') && (p[len] == '\0' || p[len] == ',')) return 1;
+    }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-t 1,2,4,...] [-n total] [-s scenario,...] [-f csv|json] [-o file] [-d dir] [-l]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    int threads[32] = {1, 2, 4, 8, 16, 32, 64};
+    int thread_count = 7;
+    uint64_t total = 100000;
+    const char* filter = NULL;
+    const char* output = NULL;
+    const char* dir = "bench_run";
+    int json = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-l") == 0) {
+            for (int s = 0; s < SCENARIO_COUNT; s++) {
+                printf("%s\n", scenarios[s].name);
+            }
+            return 0;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "-t") == 0) {
+            thread_count = parse_threads(value, threads, (int)(sizeof(threads) / sizeof(threads[0])));
+            if (thread_count <= 0) {
+                fprintf(stderr, "Invalid thread list: %s (1-%d)\n", value, BENCH_MAX_THREADS);
+                return 1;
+            }
+        } else if (strcmp(arg, "-n") == 0) {
+            total = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "-s") == 0) {
+            filter = value;
+        } else if (strcmp(arg, "-f") == 0) {
+            if (strcmp(value, "json") == 0) {
+                json = 1;
+            } else if (strcmp(value, "csv") == 0) {
+                json = 0;
+            } else {
+                fprintf(stderr, "Invalid output format: %s (csv|json)\n", value);
+                return 1;
+            }
+        } else if (strcmp(arg, "-o") == 0) {
+            output = value;
+        } else if (strcmp(arg, "-d") == 0) {
+            dir = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (total == 0) total = 1;
+
+    // 结果写到原标准输出（或 -o 指定的文件），标准输出本身重定向到 /dev/null 以承接 SCREEN 场景的日志
+    FILE* out = output ? fopen(output, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (!out) {
+        fprintf(stderr, "Error opening output: %s\n", output ? output : "stdout");
+        return 1;
+    }
+    if (!freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Error redirecting stdout\n");
+        return 1;
+    }
+    if ((mkdir(dir, 0755) != 0 && errno != EEXIST) || chdir(dir) != 0 || write_config() != 0) {
+        fprintf(stderr, "Error preparing work directory: %s\n", dir);
+        return 1;
+    }
+    memset(long_message, 'x', sizeof(long_message) - 1);
+
+    print_header(out, json);
+    int first = 1;
+    for (int s = 0; s < SCENARIO_COUNT; s++) {
+        if (!scenario_selected(filter, scenarios[s].name)) continue;
+        for (int t = 0; t < thread_count; t++) {
+            struct bench_result result;
+            if (bench_run(&scenarios[s], threads[t], total, &result) != 0) {
+                fprintf(stderr, "Error running %s with %d threads\n", scenarios[s].name, threads[t]);
+                continue;
+            }
+            print_result(out, json, first, &result);
+            first = 0;
+        }
+    }
+    if (json) {
+        fprintf(out, "\n]}\n");
+    }
+    fclose(out);
+    return 0;
+}
@@ -1,19 +1,88 @@
 #ifndef LOG_LOG_H
 #define LOG_LOG_H
 
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 
 #define LOGGER_CONFIG "dlog.properties"
 
-// 每条日志的最大长度
-#define MAX_BUFFER 4096
-// 是否使用异步日志
+// 每条日志的最大长度，超过则截断
+#ifndef MAX_BUFFER
+#define MAX_BUFFER (64 * 1024)
+#endif
+// 未配置 logger.X.mode 时的默认写出方式
+#ifndef ASYNC_LOG
 #define ASYNC_LOG 0  // 0-同步日志，1-异步日志
+#endif
+// 异步写出线程个数，可用 dlog.writer_threads 覆盖
+#ifndef DLOG_WRITER_THREADS
+#define DLOG_WRITER_THREADS 1
+#endif
+#define DLOG_MAX_WRITER_THREADS 16
+// 异步日志环形队列槽位数（必须为2的幂，且不小于日志内存池大小）
+#define ASYNC_QUEUE_SIZE 2048
+// 异步线程每批最多处理的日志条数，同一文件的日志整批一次 writev 写出
+#ifndef ASYNC_BATCH_SIZE
+#define ASYNC_BATCH_SIZE 256
+#endif
+// 批次未满时异步线程最多额外等待的毫秒数（0 表示取空队列后立即写出）
+#ifndef ASYNC_BATCH_LATENCY_MS
+#define ASYNC_BATCH_LATENCY_MS 0
+#endif
 // 日志内存池大小（同步时建议和线程个数一致；异步时尽量大一点）
-#define LOG_BUFFER_POOL_SIZE 500
-// 日志文件最大大小，超过则重命名
+#define LOG_BUFFER_POOL_SIZE 2048
+// 每个日志缓冲区自带的消息空间，更长的消息从按大小分级的消息区借用整块（1K/2K/4K/...，最大 MAX_BUFFER）
+#define LOG_INLINE_MESSAGE_SIZE 256
+// 消息区每个大小级别预分配的字节数
+#define LOG_ARENA_CLASS_BYTES (256 * 1024)
+// 日志内存池是否优先使用大页（失败时退回普通页并建议透明大页）
+#ifndef DLOG_ARENA_HUGE_PAGES
+#define DLOG_ARENA_HUGE_PAGES 0
+#endif
+// 每个线程本地缓存的日志缓冲区个数，缓存空/满时与全局空闲栈成批交换一半
+#define LOG_BUFFER_CACHE_SIZE 16
+// 飞行记录器每个条目保存捕获参数（或已格式化消息）的字节数，超出时截断
+#ifndef DLOG_RECORDER_ENTRY_SIZE
+#define DLOG_RECORDER_ENTRY_SIZE 256
+#endif
+// 可启用飞行记录器的实例个数上限（每个线程按实例序号找到自己的记录环）
+#define DLOG_RECORDER_MAX_LOGGERS 64
+// 崩溃日志环数据区的默认大小（dlog.crash_journal_size 未配置时）
+#ifndef DLOG_JOURNAL_SIZE
+#define DLOG_JOURNAL_SIZE (4 * 1024 * 1024)
+#endif
+// 调用点限流跳过条数的汇报周期（毫秒）
+#ifndef DLOG_LIMIT_REPORT_MS
+#define DLOG_LIMIT_REPORT_MS 1000
+#endif
+// 日志文件默认滚动大小（rotate_size 未配置时），超过则由后台线程重命名
 #define MAX_LOG_FILE_SIZE (10 * 1024 * 1024) // 10MB
+// 每个文件实例的追加写缓冲大小，缓冲满时立即落盘
+#define LOG_WRITE_BUFFER_SIZE (64 * 1024)
+// MMAP 输出每个预分配映射段的大小，必须是页大小的整数倍
+#ifndef DLOG_MMAP_SEGMENT_SIZE
+#define DLOG_MMAP_SEGMENT_SIZE (4 * 1024 * 1024)
+#endif
+// 默认落盘策略下缓冲数据的最长停留时间（毫秒），可用 logger.X.flush 覆盖
+#ifndef DLOG_FLUSH_INTERVAL_MS
+#define DLOG_FLUSH_INTERVAL_MS 200
+#endif
+// 后台线程检查待落盘数据的周期（毫秒）
+#define DLOG_BG_TICK_MS 10
+// 滚动文件压缩线程默认可占用的 CPU 百分比，可用 logger.X.compress_cpu 覆盖
+#ifndef DLOG_COMPRESS_CPU_PERCENT
+#define DLOG_COMPRESS_CPU_PERCENT 20
+#endif
+// 日志时间戳使用的时钟；对精度要求不高时可改为 CLOCK_REALTIME_COARSE 以降低取时开销
+#ifndef DLOG_TIME_CLOCK
+#define DLOG_TIME_CLOCK CLOCK_REALTIME
+#endif
+
+// 统计延迟直方图：每条日志在调用线程和写出时各多取一次 CLOCK_MONOTONIC，设为 0 时只统计计数
+#ifndef DLOG_STATS_TIMING
+#define DLOG_STATS_TIMING 1
+#endif
 
 // 是否启用调试日志，启用后会打印更多内部状态到stderr
 // #define DLOG_DEBUG
@@ -25,8 +94,106 @@
 #endif
 #define DLOG_ERROR_PRINT(fmt, ...) fprintf(stderr, "[DLOG ERROR] " fmt, ##__VA_ARGS__)
 
-// 注册日志模块，返回实例
-#define LOG_MODULE_INIT(module) log_module_init(#module)
+// 编译期最低日志等级，低于该等级的日志调用会被编译器直接移除（可通过 -DDLOG_MIN_LEVEL=LOG_WARN 覆盖）
+#ifndef DLOG_MIN_LEVEL
+#define DLOG_MIN_LEVEL LOG_DEBUG
+#endif
+
+// 注册日志模块，返回实例；每个调用点只解析一次，结果缓存在调用点的静态变量中
+#define LOG_MODULE_INIT(module) ({                                          \
+    static void *_dlog_handle = NULL;                                        \
+    void *_dlog_h = __atomic_load_n(&_dlog_handle, __ATOMIC_ACQUIRE);        \
+    if (__builtin_expect(_dlog_h == NULL, 0)) {                              \
+        _dlog_h = log_module_init(#module);                                  \
+        __atomic_store_n(&_dlog_handle, _dlog_h, __ATOMIC_RELEASE);          \
+    }                                                                        \
+    _dlog_h;                                                                 \
+})
+
+// 带等级过滤的日志输出：先做编译期判断，再读取实例的原子等级，被过滤的调用不会求值任何可变参数
+#define LOG_MODULE_MSG(module, level, format, ...) do {                     \
+    if ((level) >= DLOG_MIN_LEVEL) {                                         \
+        void *_dlog_logger = LOG_MODULE_INIT(module);                        \
+        if (log_level_enabled(_dlog_logger, (level))) {                      \
+            log_msg(_dlog_logger, (level), format, ##__VA_ARGS__);           \
+        }                                                                    \
+    }                                                                        \
+} while (0)
+
+// 调用点源文件名（不含目录），可在编译期求值
+#define DLOG_FILENAME (__builtin_strrchr(__FILE__, '/') ? __builtin_strrchr(__FILE__, '/') + 1 : __FILE__)
+
+// 带调用点前缀的日志输出：文件名、函数名、行号和格式串保存在调用点的静态描述中，
+// 由库在写出时补上 "<pid,tid,file,func,line> " 前缀（二进制输出不记录），调用线程不做额外的系统调用和格式化
+#define LOG_SITE_MSG(module, level, format, ...) do {                       \
+    if ((level) >= DLOG_MIN_LEVEL) {                                         \
+        void *_dlog_logger = LOG_MODULE_INIT(module);                        \
+        if (log_level_enabled(_dlog_logger, (level))) {                      \
+            static const struct dlog_site _dlog_site = {                     \
+                #module, (level), DLOG_FILENAME, __func__, __LINE__, format  \
+            };                                                               \
+            log_site_msg(_dlog_logger, &_dlog_site, ##__VA_ARGS__);          \
+        }                                                                    \
+    }                                                                        \
+} while (0)
+
+// 类型化日志输出：参数按出现顺序拼接成消息，由 _Generic 在编译期按类型选择转换方式，
+// 写出时不解析格式串、不经过 vsnprintf；整数和浮点数直接转换到日志缓冲区。最多 DLOG_MAX_VALUES 个参数
+//   LOG_TYPED_MSG(d_mod_1, LOG_INFO, "request ", id, " status=", status, " addr=0x", DLOG_HEX(addr), " cost=", DLOG_FIXED(ms, 3));
+#define LOG_TYPED_MSG(module, level, ...) do {                              \
+    if ((level) >= DLOG_MIN_LEVEL) {                                         \
+        void *_dlog_logger = LOG_MODULE_INIT(module);                        \
+        if (log_level_enabled(_dlog_logger, (level))) {                      \
+            const struct dlog_value _dlog_values[] = { DLOG_VALUES(__VA_ARGS__) }; \
+            log_typed_msg(_dlog_logger, (level), _dlog_values,               \
+                          (int)(sizeof(_dlog_values) / sizeof(_dlog_values[0]))); \
+        }                                                                    \
+    }                                                                        \
+} while (0)
+
+// 结构化日志：消息加若干键值对，值按类型编码；按实例的 format 输出为 text（msg k=v）、json 或 logfmt。
+// 键须为字符串，最多 DLOG_MAX_VALUES / 2 对；logfmt 中键的空格、等号、引号、反斜杠和控制字符写作 '_'
+//   LOG_KV(d_mod_1, LOG_INFO, "request done", "id", id, "status", status, "peer", peer);
+#define LOG_KV(module, level, msg, ...) do {                                \
+    if ((level) >= DLOG_MIN_LEVEL) {                                         \
+        void *_dlog_logger = LOG_MODULE_INIT(module);                        \
+        if (log_level_enabled(_dlog_logger, (level))) {                      \
+            const struct dlog_value _dlog_kvs[] = { DLOG_VALUES(__VA_ARGS__) }; \
+            log_kv_values(_dlog_logger, (level), (msg), _dlog_kvs,           \
+                          (int)(sizeof(_dlog_kvs) / sizeof(_dlog_kvs[0])));   \
+        }                                                                    \
+    }                                                                        \
+} while (0)
+
+// 按调用点限流和采样：在求值可变参数、取日志缓冲区和格式化之前判断，调用点状态为静态变量，只用原子操作
+//   LOG_RATE_LIMIT(module, level, n, format, ...)  每秒最多 n 条（令牌桶，允许 n 条突发）
+//   LOG_EVERY_N(module, level, n, format, ...)     每 n 次调用写一条（采样，不汇报跳过的条数）
+//   LOG_FIRST_N(module, level, n, format, ...)     只写前 n 条
+// 限流和 FIRST_N 跳过的条数由后台线程每 DLOG_LIMIT_REPORT_MS 汇总为一行 "suppressed <N> similar messages"，带该调用点前缀
+#define LOG_RATE_LIMIT(module, level, n, format, ...)                       \
+    DLOG_LIMITED_MSG(module, level, dlog_limit_rate(&_dlog_limit, (n)), 1, format, ##__VA_ARGS__)
+#define LOG_EVERY_N(module, level, n, format, ...)                          \
+    DLOG_LIMITED_MSG(module, level, dlog_limit_every(&_dlog_limit, (n)), 0, format, ##__VA_ARGS__)
+#define LOG_FIRST_N(module, level, n, format, ...)                          \
+    DLOG_LIMITED_MSG(module, level, dlog_limit_first(&_dlog_limit, (n)), 1, format, ##__VA_ARGS__)
+
+// 限流宏的公共部分：allow 为放行判断（可引用调用点状态 _dlog_limit），report 非零时登记被跳过的条数
+#define DLOG_LIMITED_MSG(module, level, allow, report, format, ...) do {    \
+    if ((level) >= DLOG_MIN_LEVEL) {                                         \
+        void *_dlog_logger = LOG_MODULE_INIT(module);                        \
+        if (log_level_enabled(_dlog_logger, (level))) {                      \
+            static const struct dlog_site _dlog_site = {                     \
+                #module, (level), DLOG_FILENAME, __func__, __LINE__, format  \
+            };                                                               \
+            static struct dlog_limit _dlog_limit;                            \
+            if (allow) {                                                     \
+                log_site_msg(_dlog_logger, &_dlog_site, ##__VA_ARGS__);      \
+            } else if (report) {                                             \
+                dlog_limit_suppressed(&_dlog_limit, _dlog_logger, &_dlog_site); \
+            }                                                                \
+        }                                                                    \
+    }                                                                        \
+} while (0)
 
 #define CHECK(x,m,handle) if((x) == (m)){   \
                            handle;          \
@@ -46,15 +213,240 @@ typedef enum {
 typedef enum {
     OUTPUT_FILE = 0,
     OUTPUT_SCREEN,
-    OUTPUT_NONE
+    OUTPUT_NONE,
+    OUTPUT_BINARY,      // 紧凑二进制日志，需用 dlog_decode 还原为文本
+    OUTPUT_MMAP         // 内存映射文件：写入线程无锁预留偏移后直接拷贝，无系统调用
 } log_type;
 
+/* 调用点描述：每个 LOG_SITE_MSG 调用点一个静态实例 */
+struct dlog_site {
+    const char *module;
+    log_level level;
+    const char *file;
+    const char *func;
+    int line;
+    const char *format;
+};
+
+/* 调用点限流状态：每个 LOG_RATE_LIMIT / LOG_EVERY_N / LOG_FIRST_N 调用点一个静态实例（零初始化） */
+struct dlog_limit {
+    uint64_t state;         // RATE：令牌桶的理论到达时刻（CLOCK_MONOTONIC 纳秒）；EVERY_N / FIRST_N：调用次数
+    uint64_t suppressed;    // 尚未汇报的跳过条数
+    int registered;         // 已登记到后台线程的汇报链表
+    void *logger;
+    const struct dlog_site *site;
+    struct dlog_limit *next;
+};
+
+/* 类型化参数：DLOG_VALUE 按参数类型构造，DLOG_HEX / DLOG_FIXED 指定十六进制和浮点小数位数 */
+typedef enum {
+    DLOG_VALUE_INT = 1,     // 有符号整数，十进制
+    DLOG_VALUE_UINT,        // 无符号整数，十进制
+    DLOG_VALUE_HEX,         // 无符号整数，小写十六进制，不带 0x
+    DLOG_VALUE_FLOAT,       // 定点小数，默认 6 位（同 %f）
+    DLOG_VALUE_CHAR,
+    DLOG_VALUE_STR,         // NULL 输出为 (null)
+    DLOG_VALUE_PTR          // 同 %p
+} dlog_value_type;
+
+struct dlog_value {
+    int type;
+    int precision;          // 仅 DLOG_VALUE_FLOAT 使用
+    union {
+        long long i;
+        unsigned long long u;
+        double f;
+        const char *s;
+        const void *p;
+    } v;
+};
+
+#define DLOG_MAX_VALUES 32
+#define DLOG_FLOAT_PRECISION 6
+
+struct dlog_hex { unsigned long long value; };
+struct dlog_fixed { double value; int precision; };
+#define DLOG_HEX(x)           ((struct dlog_hex){ (unsigned long long)(x) })
+#define DLOG_FIXED(x, digits) ((struct dlog_fixed){ (double)(x), (digits) })
+
+static inline struct dlog_value dlog_value_int(long long x) {
+    struct dlog_value value = { DLOG_VALUE_INT, 0, { .i = x } };
+    return value;
+}
+static inline struct dlog_value dlog_value_uint(unsigned long long x) {
+    struct dlog_value value = { DLOG_VALUE_UINT, 0, { .u = x } };
+    return value;
+}
+static inline struct dlog_value dlog_value_hex(struct dlog_hex x) {
+    struct dlog_value value = { DLOG_VALUE_HEX, 0, { .u = x.value } };
+    return value;
+}
+static inline struct dlog_value dlog_value_float(double x) {
+    struct dlog_value value = { DLOG_VALUE_FLOAT, DLOG_FLOAT_PRECISION, { .f = x } };
+    return value;
+}
+static inline struct dlog_value dlog_value_fixed(struct dlog_fixed x) {
+    struct dlog_value value = { DLOG_VALUE_FLOAT, x.precision, { .f = x.value } };
+    return value;
+}
+static inline struct dlog_value dlog_value_char(char x) {
+    struct dlog_value value = { DLOG_VALUE_CHAR, 0, { .i = x } };
+    return value;
+}
+static inline struct dlog_value dlog_value_str(const char *x) {
+    struct dlog_value value = { DLOG_VALUE_STR, 0, { .s = x } };
+    return value;
+}
+static inline struct dlog_value dlog_value_ptr(const void *x) {
+    struct dlog_value value = { DLOG_VALUE_PTR, 0, { .p = x } };
+    return value;
+}
+
+// 按参数类型选择构造函数；不支持的类型（如结构体）在编译期报错
+#define DLOG_VALUE(x) _Generic((x),                                         \
+    _Bool: dlog_value_uint,                                                  \
+    char: dlog_value_char,                                                   \
+    signed char: dlog_value_int, short: dlog_value_int, int: dlog_value_int, \
+    long: dlog_value_int, long long: dlog_value_int,                         \
+    unsigned char: dlog_value_uint, unsigned short: dlog_value_uint,         \
+    unsigned int: dlog_value_uint, unsigned long: dlog_value_uint,           \
+    unsigned long long: dlog_value_uint,                                     \
+    float: dlog_value_float, double: dlog_value_float,                       \
+    char *: dlog_value_str, const char *: dlog_value_str,                    \
+    struct dlog_hex: dlog_value_hex,                                         \
+    struct dlog_fixed: dlog_value_fixed,                                     \
+    default: dlog_value_ptr)(x)
+
+// 对每个参数应用 DLOG_VALUE（最多 DLOG_MAX_VALUES 个）
+#define DLOG_VALUES_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16,             \
+                      _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32,   \
+                      N, ...) DLOG_VALUES_##N
+#define DLOG_VALUES(...) DLOG_VALUES_N(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, \
+                                       16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)(__VA_ARGS__)
+#define DLOG_VALUES_1(a)       DLOG_VALUE(a)
+#define DLOG_VALUES_2(a, ...)  DLOG_VALUE(a), DLOG_VALUES_1(__VA_ARGS__)
+#define DLOG_VALUES_3(a, ...)  DLOG_VALUE(a), DLOG_VALUES_2(__VA_ARGS__)
+#define DLOG_VALUES_4(a, ...)  DLOG_VALUE(a), DLOG_VALUES_3(__VA_ARGS__)
+#define DLOG_VALUES_5(a, ...)  DLOG_VALUE(a), DLOG_VALUES_4(__VA_ARGS__)
+#define DLOG_VALUES_6(a, ...)  DLOG_VALUE(a), DLOG_VALUES_5(__VA_ARGS__)
+#define DLOG_VALUES_7(a, ...)  DLOG_VALUE(a), DLOG_VALUES_6(__VA_ARGS__)
+#define DLOG_VALUES_8(a, ...)  DLOG_VALUE(a), DLOG_VALUES_7(__VA_ARGS__)
+#define DLOG_VALUES_9(a, ...)  DLOG_VALUE(a), DLOG_VALUES_8(__VA_ARGS__)
+#define DLOG_VALUES_10(a, ...) DLOG_VALUE(a), DLOG_VALUES_9(__VA_ARGS__)
+#define DLOG_VALUES_11(a, ...) DLOG_VALUE(a), DLOG_VALUES_10(__VA_ARGS__)
+#define DLOG_VALUES_12(a, ...) DLOG_VALUE(a), DLOG_VALUES_11(__VA_ARGS__)
+#define DLOG_VALUES_13(a, ...) DLOG_VALUE(a), DLOG_VALUES_12(__VA_ARGS__)
+#define DLOG_VALUES_14(a, ...) DLOG_VALUE(a), DLOG_VALUES_13(__VA_ARGS__)
+#define DLOG_VALUES_15(a, ...) DLOG_VALUE(a), DLOG_VALUES_14(__VA_ARGS__)
+#define DLOG_VALUES_16(a, ...) DLOG_VALUE(a), DLOG_VALUES_15(__VA_ARGS__)
+#define DLOG_VALUES_17(a, ...) DLOG_VALUE(a), DLOG_VALUES_16(__VA_ARGS__)
+#define DLOG_VALUES_18(a, ...) DLOG_VALUE(a), DLOG_VALUES_17(__VA_ARGS__)
+#define DLOG_VALUES_19(a, ...) DLOG_VALUE(a), DLOG_VALUES_18(__VA_ARGS__)
+#define DLOG_VALUES_20(a, ...) DLOG_VALUE(a), DLOG_VALUES_19(__VA_ARGS__)
+#define DLOG_VALUES_21(a, ...) DLOG_VALUE(a), DLOG_VALUES_20(__VA_ARGS__)
+#define DLOG_VALUES_22(a, ...) DLOG_VALUE(a), DLOG_VALUES_21(__VA_ARGS__)
+#define DLOG_VALUES_23(a, ...) DLOG_VALUE(a), DLOG_VALUES_22(__VA_ARGS__)
+#define DLOG_VALUES_24(a, ...) DLOG_VALUE(a), DLOG_VALUES_23(__VA_ARGS__)
+#define DLOG_VALUES_25(a, ...) DLOG_VALUE(a), DLOG_VALUES_24(__VA_ARGS__)
+#define DLOG_VALUES_26(a, ...) DLOG_VALUE(a), DLOG_VALUES_25(__VA_ARGS__)
+#define DLOG_VALUES_27(a, ...) DLOG_VALUE(a), DLOG_VALUES_26(__VA_ARGS__)
+#define DLOG_VALUES_28(a, ...) DLOG_VALUE(a), DLOG_VALUES_27(__VA_ARGS__)
+#define DLOG_VALUES_29(a, ...) DLOG_VALUE(a), DLOG_VALUES_28(__VA_ARGS__)
+#define DLOG_VALUES_30(a, ...) DLOG_VALUE(a), DLOG_VALUES_29(__VA_ARGS__)
+#define DLOG_VALUES_31(a, ...) DLOG_VALUE(a), DLOG_VALUES_30(__VA_ARGS__)
+#define DLOG_VALUES_32(a, ...) DLOG_VALUE(a), DLOG_VALUES_31(__VA_ARGS__)
+
+// 显式指定类型的值，用于 log_kv 的可变参数（可变参数无法经 _Generic 推断类型）
+#define DLOG_INT(x)   dlog_value_int((long long)(x))
+#define DLOG_UINT(x)  dlog_value_uint((unsigned long long)(x))
+#define DLOG_FLOAT(x) dlog_value_float((double)(x))
+#define DLOG_STR(x)   dlog_value_str((x))
+#define DLOG_PTR(x)   dlog_value_ptr((x))
+
+/* Statistics：dlog_get_stats 返回的实例统计快照 */
+#define DLOG_STATS_LEVELS (LOG_FATAL + 1)   // 按 log_level 取值下标
+#define DLOG_STATS_BUCKETS 32               // 对数直方图：桶 0 为 0ns，桶 i 为 [2^(i-1), 2^i) ns，最后一个桶包含更大的值
+
+struct dlog_stats {
+    uint64_t messages[DLOG_STATS_LEVELS];   // 已写出的条数
+    uint64_t bytes[DLOG_STATS_LEVELS];      // 已写出的字节数（含时间和等级标签）
+    uint64_t dropped;                       // 按溢出策略丢弃的条数
+    uint64_t truncated;                     // 超过 MAX_BUFFER 被截断的条数
+    uint64_t sync_fallbacks;                // sync_fallback 策略下由调用线程直接写出的条数
+    uint64_t rotations;                     // 已完成的文件滚动次数（共享文件时为该文件的滚动次数）
+    uint32_t queue_depth;                   // 所属写出线程的队列深度（多个实例可能共用），同步实例为 0
+    uint32_t queue_high_water;
+    uint32_t pool_in_use;                   // 全局：不在空闲栈中的缓冲区个数（含各线程本地缓存）
+    uint32_t pool_high_water;
+    uint64_t format_ns[DLOG_STATS_BUCKETS];     // 调用线程格式化（或捕获参数）耗时
+    uint64_t latency_ns[DLOG_STATS_BUCKETS];    // 从入队到交给输出端（写缓冲、write 或映射区）的延迟
+};
+
+/* Logger head: 日志实例的第一个成员，宏通过它无锁读取当前日志等级 */
+typedef struct {
+    int level;
+} log_gate;
+
+static inline int log_level_enabled(const void *logger, log_level level) {
+    return logger && (int)level >= __atomic_load_n(&((const log_gate*)logger)->level, __ATOMIC_RELAXED);
+}
+
+/* 调用点限流，通常通过 LOG_RATE_LIMIT / LOG_EVERY_N / LOG_FIRST_N 调用 */
+// 令牌桶：每秒补充 per_sec 个令牌，最多积攒 per_sec 个，取到令牌返回 1
+int dlog_limit_rate(struct dlog_limit *limit, uint32_t per_sec);
+// 首次跳过时登记到后台线程，由其定期汇报跳过的条数
+void dlog_limit_register(struct dlog_limit *limit, void *logger, const struct dlog_site *site);
+
+static inline int dlog_limit_every(struct dlog_limit *limit, uint64_t n) {
+    return n <= 1 || __atomic_fetch_add(&limit->state, 1, __ATOMIC_RELAXED) % n == 0;
+}
+
+static inline int dlog_limit_first(struct dlog_limit *limit, uint64_t n) {
+    // 超过 n 后只读不写，避免热点调用点反复争用同一缓存行
+    return __atomic_load_n(&limit->state, __ATOMIC_RELAXED) < n &&
+           __atomic_fetch_add(&limit->state, 1, __ATOMIC_RELAXED) < n;
+}
+
+static inline void dlog_limit_suppressed(struct dlog_limit *limit, void *logger, const struct dlog_site *site) {
+    __atomic_fetch_add(&limit->suppressed, 1, __ATOMIC_RELAXED);
+    if (__builtin_expect(!__atomic_load_n(&limit->registered, __ATOMIC_ACQUIRE), 0)) {
+        dlog_limit_register(limit, logger, site);
+    }
+}
+
 /* Public interface */
+// 注意：BINARY 输出和 deferred 格式化模式只保存 format 指针，format 需为字符串字面量等长期有效的字符串
 void *log_module_init(const char *module_name);
 void log_msg(void *logger, log_level logLevel, const char *format, ... );
-#if (ASYNC_LOG)
+// 按调用点描述输出一条日志，通常通过 LOG_SITE_MSG 调用
+void log_site_msg(void *logger, const struct dlog_site *site, ...);
+// 输出由类型化参数拼接的消息，通常通过 LOG_TYPED_MSG 调用；二进制输出按文本条目记录
+void log_typed_msg(void *logger, log_level level, const struct dlog_value *values, int count);
+// 结构化日志：键值对按键、值交替排列；log_kv 的可变参数为 (const char *key, struct dlog_value value) 对，以 NULL 键结尾
+//   log_kv(logger, LOG_INFO, "request done", "id", DLOG_INT(id), "peer", DLOG_STR(peer), NULL);
+void log_kv_values(void *logger, log_level level, const char *msg, const struct dlog_value *kvs, int count);
+void log_kv(void *logger, log_level level, const char *msg, ...);
+void log_set_level(void *logger, log_level level);
+// 将所有实例缓冲中的日志落盘（异步模式下先等待队列写完）
+void log_flush();
+// 等待所有写出线程写完已入队的日志并落盘
 void fflush_async_log();
-#endif
+// 重新读取 dlog.properties 并应用到已创建的实例（等级、落盘策略、滚动、输出文件等），成功返回 0；
+// 读取失败时保留当前配置。输出类型和同步/异步模式的修改需重启生效
+int dlog_reload();
+
+// 把飞行记录器中尚未写出的日志交给输出端（按线程依次、线程内按时间顺序），logger 为 NULL 时处理所有实例；
+// 返回写出的条数。异步实例只保证入队，需要落盘时再调用 log_flush
+int dlog_dump_recorder(void *logger);
+
+// 异步信号安全：把崩溃日志环中尚未写出的日志直接 write 到各自的文件，返回补写的条数；
+// 供自行处理致命信号（dlog.crash_handler = off）的程序在其信号处理函数中调用
+int dlog_journal_drain();
+
+// 读取实例的统计快照（计数为累计值，各字段分别读取、不保证彼此一致），成功返回 0
+int dlog_get_stats(void *logger, struct dlog_stats *stats);
+// 直方图的百分位数（percentile 取 0~100，如 99.9），返回所在桶的上界（纳秒），无样本时返回 0
+uint64_t dlog_stats_percentile(const uint64_t *histogram, double percentile);
 
 /* Debug interface */
 void log_buffer_debug_info();
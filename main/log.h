@@ -7,32 +7,19 @@
 #ifndef LOG_H
 #define LOG_H
 
-#include <stdint.h>
-#include <unistd.h>
-#include <sys/syscall.h>
-
 #include "../include/dlog.h"
 
-static uint64_t get_thread_id(){
-    return syscall(SYS_gettid);
-}
-
-static uint64_t get_process_id(){
-    return getpid();
-}
-
-#define __FILENAME__ ( __builtin_strrchr(__FILE__, '/') ? __builtin_strrchr(__FILE__, '/') + 1 : __FILE__ )
-#define DLOG_FORMAT_PREFIX "<%d,%d,%s,%s,%d> "
-#define DLOG_VALUE_PREFIX  get_process_id(), get_thread_id(), __FILENAME__, __FUNCTION__ , __LINE__
+// 调用点前缀 <pid,tid,file,func,line> 由库根据 LOG_SITE_MSG 的静态调用点描述写出
+#define d_mod_1_error(format, ...) LOG_SITE_MSG(d_mod_1, LOG_ERROR, #format, ##__VA_ARGS__)
+#define d_mod_1_info(format, ...)  LOG_SITE_MSG(d_mod_1, LOG_INFO, #format, ##__VA_ARGS__)
+#define d_mod_1_warn(format, ...)  LOG_SITE_MSG(d_mod_1, LOG_WARN, #format, ##__VA_ARGS__)
+#define d_mod_1_debug(format, ...) LOG_SITE_MSG(d_mod_1, LOG_DEBUG, #format, ##__VA_ARGS__)
 
-#define d_mod_1_error(format, ...) log_msg(LOG_MODULE_INIT(d_mod_1), LOG_ERROR, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
-#define d_mod_1_info(format, ...)  log_msg(LOG_MODULE_INIT(d_mod_1), LOG_INFO, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
-#define d_mod_1_warn(format, ...)  log_msg(LOG_MODULE_INIT(d_mod_1), LOG_WARN, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
-#define d_mod_1_debug(format, ...) log_msg(LOG_MODULE_INIT(d_mod_1), LOG_DEBUG, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
+#define d_mod_2_error(format, ...) LOG_SITE_MSG(d_mod_2, LOG_ERROR, #format, ##__VA_ARGS__)
+#define d_mod_2_warn(format, ...)  LOG_SITE_MSG(d_mod_2, LOG_WARN, #format, ##__VA_ARGS__)
+#define d_mod_2_info(format, ...)  LOG_SITE_MSG(d_mod_2, LOG_INFO, #format, ##__VA_ARGS__)
+#define d_mod_2_debug(format, ...) LOG_SITE_MSG(d_mod_2, LOG_DEBUG, #format, ##__VA_ARGS__)
 
-#define d_mod_2_error(format, ...) log_msg(LOG_MODULE_INIT(d_mod_2), LOG_ERROR, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
-#define d_mod_2_warn(format, ...)  log_msg(LOG_MODULE_INIT(d_mod_2), LOG_WARN, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
-#define d_mod_2_info(format, ...)  log_msg(LOG_MODULE_INIT(d_mod_2), LOG_INFO, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
-#define d_mod_2_debug(format, ...) log_msg(LOG_MODULE_INIT(d_mod_2), LOG_DEBUG, DLOG_FORMAT_PREFIX#format, DLOG_VALUE_PREFIX, ##__VA_ARGS__);
+#define d_mod_3_info(format, ...)  LOG_SITE_MSG(d_mod_3, LOG_INFO, #format, ##__VA_ARGS__)
 
 #endif //LOG_H
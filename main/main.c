@@ -1,7 +1,9 @@
 #include <stdio.h>
+#include <string.h>
 #include <pthread.h>
 
 #include "log.h"
+#include "../src/dlog_typed.h"
 
 // 简单屏幕输出测试
 void simple_test() {
@@ -49,12 +51,68 @@ void multi_thread_test() {
     }
 }
 
+// 溢出测试：drop_oldest 实例在缓冲区耗尽时取走自己排队的日志，之后 fflush_async_log 仍须返回
+void* overflow_test_func(void* arg) {
+    const int *thread_idx = (const int*)arg;
+
+    for (int i = 0; i < 20000; i++) {
+        d_mod_3_info("Thread %d - Overflow message %d", *thread_idx, i);
+    }
+    return NULL;
+}
+void overflow_flush_test() {
+    const int thread_count = 8;
+    pthread_t threads[thread_count];
+    const int thread_indices[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, overflow_test_func, (void*)&thread_indices[i]) != 0) {
+            fprintf(stderr, "Failed to create thread for thread idx: %d\n", thread_indices[i]);
+        }
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+#if (ASYNC_LOG)
+    fflush_async_log();
+#endif
+    struct dlog_stats stats;
+    if (dlog_get_stats(LOG_MODULE_INIT(d_mod_3), &stats) == 0) {
+        printf("Overflow test flushed, d_mod_3 dropped %llu messages\n", (unsigned long long)stats.dropped);
+    }
+}
+
+// 类型化浮点测试：快速路径须与 %.*f 的输出一致，包括 printf 按偶数舍入的精确 .5
+int typed_float_test() {
+    static const struct { double value; int precision; } cases[] = {
+        {0.0078125, 6}, {0.125, 2}, {2.5, 0}, {0.5, 0}, {1.5, 0}, {-0.125, 2}, {0.375, 2},
+        {1.005, 2}, {2.675, 2}, {0.1, 1}, {123456.5, 0}, {-2.5, 0}, {0.9999995, 6}, {1e17 + 0.5, 1},
+    };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char typed[64], expected[64];
+        struct dlog_value value = dlog_value_fixed(DLOG_FIXED(cases[i].value, cases[i].precision));
+        dlog_typed_render(typed, sizeof(typed), &value, 1);
+        snprintf(expected, sizeof(expected), "%.*f", cases[i].precision, cases[i].value);
+        if (strcmp(typed, expected) != 0) {
+            fprintf(stderr, "Typed float mismatch: %s (typed) vs %s (printf)\n", typed, expected);
+            failures++;
+        }
+    }
+    return failures;
+}
+
 int main() {
+    if (typed_float_test() != 0) {
+        return 1;
+    }
     // simple_test();
     multi_thread_test();
 #if (ASYNC_LOG)
     fflush_async_log();
 #endif
+    overflow_flush_test();
     log_buffer_debug_info();
     return 0;
 }
\ No newline at end of file
@@ -3,97 +3,731 @@
 #include <sys/time.h>
 #include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <pthread.h>
 #include <sched.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
 #include "../include/dlog.h"
+#include "dlog_fmt.h"
+#include "dlog_compress.h"
+#include "dlog_typed.h"
+#include "dlog_kv.h"
+#include "dlog_journal.h"
 
 /* 文件路径 */
 #define DEFAULT_FILEPATH_SIZE 128
+#define LOG_BACKUP_SEQ_MAX 999      // 同一秒内滚动文件的最大序号
 #define MAX_CONFIG_LINE_SIZE 256
 #define MAX_CONFIG_KEY_SIZE (MAX_CONFIG_LINE_SIZE / 2 - 2)
 #define MAX_CONFIG_VALUE_SIZE (MAX_CONFIG_LINE_SIZE / 2 - 2)
 #define DEFAULT_LOG_SUFFIX "default.log"
+#define LOG_FILE_OPEN_FLAGS (O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC)
+#define LOG_FILE_MODE 0644
+/* 每个实例最多的输出端个数（sinks 配置项） */
+#define MAX_LOGGER_OUTPUTS 8
 /* 时间格式 */
-#define TIME_STRING_BUFFER_SIZE 32
+#define TIME_STRING_BUFFER_SIZE 48
+// 调用点前缀 "<pid,tid,file,func,line> " 的最大长度，过长的文件名或函数名会被截断
+#define SITE_PREFIX_SIZE 128
 #define TIME_FORMAT "%Y-%m-%d %H:%M:%S"
+#define TIME_FORMAT_ISO8601 "%Y-%m-%dT%H:%M:%S"
 #define TIME_FORMAT_PLAIN "%Y%m%d_%H%M%S"
-#define MILLISECOND_FORMAT ".%03ld"
-/* 初始容量和增长因子 */
-#define INITIAL_LOGGER_CAPACITY 10
-#define CAPACITY_GROWTH_FACTOR 2
+/* 模块注册表哈希桶数量（2的幂） */
+#define LOGGER_HASH_BUCKETS 64
 /* 错误消息 */
 #define LOG_FORMAT_ERROR_MSG "[LOG FORMAT ERROR]"
 #define TRUNCATION_WARNING_MSG "Warning: log truncated (needed %ld bytes)\n"
+/* 缓存行大小，用于隔离并发写入的字段 */
+#define CACHE_LINE_SIZE 64
 
-/* Logger structure */
+/* 时间戳小数位精度 */
+typedef enum {
+    TIME_PRECISION_MS = 3,
+    TIME_PRECISION_US = 6,
+    TIME_PRECISION_NS = 9
+} time_precision;
+
+/* 时间戳样式（按位组合） */
+#define TIME_STYLE_UTC     0x1  // 使用 UTC 而不是本地时区
+#define TIME_STYLE_ISO8601 0x2  // ISO-8601：日期和时间以 T 分隔，并带时区后缀
+#define TIME_STYLE_COUNT   4
+
+/* 输出端配置：输出方式、该输出端的最低等级（0 表示只受 log_level 限制）和文件名 */
+typedef struct {
+    log_type type;
+    int level;
+    char filename[MAX_CONFIG_VALUE_SIZE];
+} output_config_t;
+
+/* Logger config：从配置文件读取的实例参数 */
 typedef struct {
     log_level level;
     log_type type;
+    char filename[MAX_CONFIG_VALUE_SIZE];
+    // 输出端列表：配置了 sinks 时按其解析，否则为 log_type / log_file 对应的单个输出端
+    output_config_t outputs[MAX_LOGGER_OUTPUTS];
+    int output_count;
+    time_precision precision;
+    int time_style;
+    int deferred;       // 异步模式下由异步线程格式化消息
+    int format;         // 行格式 DLOG_FORMAT_TEXT / JSON / LOGFMT
+    int async;          // 经异步写出线程写出
+    int writer;         // 指定的写出线程序号，-1 表示轮流分配
+    int overflow;       // 缓冲区耗尽时的处理策略
+    int flush_always;   // 每次写入后立即落盘
+    int flush_level;    // 包含该等级及以上日志时立即落盘，0 表示不按等级
+    int flush_interval_ms;  // 缓冲数据最长停留时间，由后台线程定时落盘
+    size_t flush_bytes; // 缓冲数据达到该字节数时落盘，0 表示只在缓冲区满时
+    uint64_t rotate_size;   // 文件超过该字节数时滚动，0 表示不按大小滚动
+    int rotate_time;        // 按时间滚动：ROTATE_NONE / ROTATE_HOURLY / ROTATE_DAILY
+    int max_files;          // 最多保留的滚动文件个数，0 表示不限
+    int compress;           // 滚动文件的压缩方式 dlog_compress_type
+    int compress_cpu;       // 压缩线程可占用的 CPU 百分比
+    int recorder_entries;   // 飞行记录器每个线程保留的条数，0 表示不启用
+} logger_config_t;
+
+/* 配置表：dlog.properties 只解析一次，按完整键（如 logger.d_mod_1.log_level）建立哈希索引 */
+#define CONFIG_HASH_BUCKETS 128
+
+typedef struct config_entry {
+    char* key;
+    char* value;
+    uint32_t hash;
+    struct config_entry* next;
+} config_entry_t;
+
+typedef struct {
+    config_entry_t* buckets[CONFIG_HASH_BUCKETS];
+    int count;
+} config_table_t;
+
+/* 缓冲区耗尽（或异步队列已满）时的处理策略 */
+#define OVERFLOW_BLOCK          0   // 等待其他线程归还缓冲区
+#define OVERFLOW_DROP_NEW       1   // 丢弃当前日志
+#define OVERFLOW_DROP_OLDEST    2   // 从队列中取走该实例最早的一条日志腾出缓冲区，没有时丢弃当前日志
+#define OVERFLOW_SYNC_FALLBACK  3   // 在调用线程中用栈上缓冲直接写出
+
+/* 按时间滚动的周期 */
+#define ROTATE_NONE   0
+#define ROTATE_HOURLY 1
+#define ROTATE_DAILY  2
+
+/* 二进制日志的格式串 id 表（按格式串指针开放寻址） */
+typedef struct {
+    const char* format;
+    uint32_t id;
+} format_id_slot;
+
+/* 内存映射输出：文件按 DLOG_MMAP_SEGMENT_SIZE 分段预分配并映射，
+ * 写入线程对 pos 原子 fetch-add 预留偏移后直接 memcpy 到映射区，跨段的日志分两段拷贝 */
+#define MMAP_SEGMENT_SLOTS 4
+#define MMAP_SLOT_EMPTY UINT64_MAX
+
+typedef struct {
+    uint64_t index;     // 当前映射的段号，MMAP_SLOT_EMPTY 表示空闲
+    char* base;         // NULL 表示该段映射失败，写入者丢弃数据但照常计入 committed
+    uint64_t committed; // 该段已写完的字节数，写满时由最后一个写入者解除映射
+} mmap_slot;
+
+typedef struct {
+    int fd;
+    uint64_t start;     // 打开时文件已有的长度，新日志从这里续写
+    uint64_t pos;       // 下一条日志的文件偏移
+    mmap_slot slots[MMAP_SEGMENT_SLOTS];  // 段 k 使用 slots[k % MMAP_SEGMENT_SLOTS]
+    pthread_mutex_t map_mutex;  // 只在映射新段时使用
+} mmap_sink;
+
+struct async_writer;
+
+/* 实例统计：计数按线程分散到 STATS_SHARDS 个缓存行对齐的分片，dlog_get_stats 读取时汇总 */
+#define STATS_SHARDS 8
+struct logger_stats_shard {
+    uint64_t messages[DLOG_STATS_LEVELS];
+    uint64_t bytes[DLOG_STATS_LEVELS];
+    uint64_t truncated;
+    uint64_t format_ns[DLOG_STATS_BUCKETS];
+    uint64_t latency_ns[DLOG_STATS_BUCKETS];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/* 输出文件：同一路径的实例共享一个 sink（一个描述符、一个追加写缓冲和一份滚动状态），按引用计数管理 */
+typedef struct log_sink {
     char* filename;
-    FILE* file;
+    char* path;         // 规范化的绝对路径，用于识别同一文件
+    log_type type;
+    int fd;             // 文件关闭后为 -1
+    int refs;           // 使用该文件的实例数，受 sink_ctl.mutex 保护，归零时关闭文件
     pthread_mutex_t filemutex;
+    // 追加写缓冲，受 filemutex 保护
+    char* write_buf;
+    size_t write_len;
+    uint64_t pending_since_ms;  // 缓冲区从空变为非空的时刻
+    // 滚动状态：写入线程只累加字节数并在超限时通知后台线程，改名、重新打开和清理都在后台线程中完成
+    uint64_t file_bytes;
+    int rotate_pending;
+    int reschedule_rotate;  // 重新加载配置后由后台线程重新计算滚动时刻
+    time_t next_rotate_at;  // 下一次按时间滚动的时刻，仅后台线程访问
+    uint64_t rotate_size;
+    int rotate_time;
+    int max_files;
+    int compress;
+    int compress_cpu;
+    uint64_t rotations;     // 仅后台线程累加
+    // 仅 OUTPUT_MMAP 使用：滚动时替换 mmap，等 mmap_writers 归零后再关闭旧文件
+    mmap_sink* mmap;
+    int mmap_writers;
+    // 仅 OUTPUT_BINARY 使用：格式串定义写在文件中，id 表随文件共享，受 filemutex 保护
+    format_id_slot* format_ids;
+    uint32_t format_id_capacity;
+    uint32_t format_id_count;
+    struct log_sink* next;
+} log_sink;
+
+/* 实例的一个输出端：同一条日志只格式化一次，再依次交给等级满足的各输出端 */
+struct logger_output {
+    log_type type;
+    int level;          // 该输出端的最低等级，0 表示只受实例日志等级限制
+    log_sink* sink;     // 文件类输出的输出文件，其他输出方式为 NULL
+    char* filename;     // 配置的文件名，只在 register_mutex 下访问
+    int journal_file;   // 在崩溃日志环文件表中的下标，-1 表示不记录
+};
+
+/* 飞行记录器：每个线程每个实例一个定长记录环，只由所属线程写入，条目按序号做顺序锁，
+ * 其他线程写出时复制条目并校验序号，跳过正在被覆盖的条目 */
+struct recorder_entry {
+    uint64_t seq;                   // 写入第 n 条时先置为 2n+1，写完置为 2n+2
+    struct timespec ts;             // 原始时间戳，写出时才格式化
+    const char* format;             // 非 NULL 时 data 中是捕获的参数，否则是已格式化的消息
+    const struct dlog_site* site;
+    pid_t tid;
+    uint32_t len;                   // data 的有效字节数
+    uint8_t level;
+    char data[DLOG_RECORDER_ENTRY_SIZE];
+};
+
+struct recorder_ring {
+    pid_t owner;                    // 所属线程号，0 表示线程已退出、可被新线程认领
+    uint64_t head;                  // 已写入的条数，只由所属线程修改
+    uint64_t dumped;                // 已写出到的位置，受 recorder_mutex 保护
+    uint32_t capacity;
+    struct recorder_ring* next;
+    struct recorder_entry entries[];
+};
+
+static uint32_t recorder_next_id = 0;  // 受 register_mutex 保护
+static __thread struct recorder_ring* recorder_tls[DLOG_RECORDER_MAX_LOGGERS];
+static pthread_key_t recorder_key;
+static pthread_once_t recorder_key_once = PTHREAD_ONCE_INIT;
+
+/* Logger structure */
+typedef struct {
+    log_gate gate;      // 必须为第一个成员，宏通过它读取日志等级
+    struct logger_output outputs[MAX_LOGGER_OUTPUTS];
+    int output_count;
+    int binary_outputs; // 二进制输出端个数：有二进制输出时捕获参数，全部为二进制输出时不记录调用点
+    int journal;        // 文件输出端登记在崩溃日志环中：入队时记录格式化后的消息，不做延迟格式化
+    time_precision precision;
+    int time_style;
+    int deferred;
+    // 行格式：json / logfmt 时每个等级的 "等级 + 实例名" 字段在创建时编码好，写出时直接引用
+    int format;
+    char* level_heads;
+    const char* level_head[DLOG_STATS_LEVELS];
+    uint32_t level_head_len[DLOG_STATS_LEVELS];
+    struct async_writer* writer;    // 所属的异步写出线程，NULL 表示同步写出
+    int overflow;
+    // 溢出计数：dropped 由丢弃日志的线程累加，其余只由后台线程访问
+    uint64_t dropped;
+    uint64_t dropped_reported;  // 已写出汇总行的丢弃数
+    uint64_t dropped_seen;      // 上一个后台周期看到的丢弃数
+    uint64_t sync_fallbacks;    // sync_fallback 策略下由调用线程直接写出的条数
+    struct logger_stats_shard* stats;   // STATS_SHARDS 个分片
+    // 落盘策略，重新加载时以原子写替换
+    int flush_always;
+    int flush_level;
+    int flush_interval_ms;
+    size_t flush_bytes;
+    // 飞行记录器：低于 record_level 的日志只记入调用线程的记录环，不写出；
+    // 该线程输出 ERROR/FATAL 或调用 dlog_dump_recorder 时再交给输出端。启用时 gate 固定为 LOG_DEBUG
+    int record_level;           // 0 表示未启用
+    int recorder_id;            // 线程本地记录环数组的下标
+    uint32_t recorder_entries;  // 每个记录环的条数
+    struct recorder_ring* rings;    // 各线程的记录环，线程退出后留给新线程复用
+    pthread_mutex_t recorder_mutex; // 保护 rings 链表、记录环的认领和写出
 } logger_t;
 
-/* Logger control structure */
+/* Logger registry entry：一经发布不再修改，读者无需加锁 */
+typedef struct logger_entry {
+    char* module_name;
+    uint32_t hash;
+    logger_t* logger;
+    struct logger_entry* next;      // 同一哈希桶中的下一个
+    struct logger_entry* all_next;  // 按注册顺序串起所有实例，用于遍历和释放
+} logger_entry_t;
+
+/* Logger control structure：读无锁，注册时由 register_mutex 串行化 */
 typedef struct {
-    logger_t** loggers;
-    char** module_names;
+    logger_entry_t* buckets[LOGGER_HASH_BUCKETS];
+    logger_entry_t* all;
     int count;
-    int capacity;
+    pthread_mutex_t register_mutex;
 } logger_ctl_t;
 
-static logger_ctl_t* logger_ctl_inst = NULL;
+static logger_ctl_t logger_ctl_inst = {
+    .register_mutex = PTHREAD_MUTEX_INITIALIZER,
+};
 
-static void logger_ctl_get_config(const char* name, log_type* type, log_level* level, char* filename) {
-    char config_path[DEFAULT_FILEPATH_SIZE];
-    snprintf(config_path, sizeof(config_path), "./%s", LOGGER_CONFIG);
-    
-    FILE* file = fopen(config_path, "r");
-    if (!file){
-        DLOG_ERROR_PRINT("Error opening config file: %s\n", config_path);
-        return;
+// 输出文件表：按路径查找共享的 sink；sink 只增不删（关闭后可被重新打开），退出时统一释放，
+// 写入线程和后台线程持有的 sink 指针始终有效。锁顺序：register_mutex -> sink_ctl.mutex -> filemutex
+static struct {
+    log_sink* all;
+    pthread_mutex_t mutex;
+} sink_ctl = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// 后台线程：定时落盘缓冲数据，并执行日志滚动
+static struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int running;
+} bg_ctl = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// 压缩线程：以最低调度优先级依次压缩滚动后的文件
+typedef struct compress_job {
+    struct compress_job* next;
+    log_sink* sink;
+    char path[PATH_MAX];
+    char filename[PATH_MAX];    // 提交时的日志文件名，重新加载配置可能在压缩期间替换文件名
+} compress_job;
+
+static struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    compress_job* head;
+    compress_job* tail;
+    int running;
+    int stopping;   // 退出时中止正在进行的压缩，原文件保持不变
+} compress_ctl = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+static pthread_once_t compress_thread_once = PTHREAD_ONCE_INIT;
+
+static int parse_level(const char* value, int* level) {
+    if (strcmp(value, "DEBUG") == 0) {
+        *level = LOG_DEBUG;
+    } else if (strcmp(value, "WARN") == 0) {
+        *level = LOG_WARN;
+    } else if (strcmp(value, "INFO") == 0) {
+        *level = LOG_INFO;
+    } else if (strcmp(value, "ERROR") == 0) {
+        *level = LOG_ERROR;
+    } else if (strcmp(value, "FATAL") == 0) {
+        *level = LOG_FATAL;
+    } else {
+        return -1;
     }
-    
-    char buffer[MAX_CONFIG_LINE_SIZE];
-    while (fgets(buffer, sizeof(buffer), file) != NULL) {
-        if (buffer[0] == '#') continue;
-        
-        char key[MAX_CONFIG_KEY_SIZE], value[MAX_CONFIG_VALUE_SIZE];
-        if (sscanf(buffer, "%125s = %125s", key, value) != 2) continue;
-        
-        // Check if this is the config for our module
-        char search_str[MAX_CONFIG_KEY_SIZE];
-        snprintf(search_str, sizeof(search_str), ".%s.", name);
-        if (!strstr(key, search_str)) continue;
-        
-        if (strstr(key, ".log_level")) {
-            if (strcmp(value, "DEBUG") == 0) {
-                *level = LOG_DEBUG;
-            } else if (strcmp(value, "WARN") == 0) {
-                *level = LOG_WARN;
-            } else if (strcmp(value, "INFO") == 0) {
-                *level = LOG_INFO;
-            } else if (strcmp(value, "ERROR") == 0) {
-                *level = LOG_ERROR;
-            } else if (strcmp(value, "FATAL") == 0) {
-                *level = LOG_FATAL;
+    return 0;
+}
+
+// 落盘策略：always | interval:<ms> | bytes:<n> | level:<LEVEL>，可用逗号组合
+static void parse_flush_policy(char* value, logger_config_t* config) {
+    config->flush_always = 0;
+    config->flush_level = 0;
+    config->flush_bytes = 0;
+    char* saveptr = NULL;
+    for (char* term = strtok_r(value, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+        if (strcmp(term, "always") == 0) {
+            config->flush_always = 1;
+        } else if (strncmp(term, "interval:", 9) == 0) {
+            config->flush_interval_ms = atoi(term + 9);
+        } else if (strncmp(term, "bytes:", 6) == 0) {
+            config->flush_bytes = (size_t)strtoull(term + 6, NULL, 10);
+        } else if (strncmp(term, "level:", 6) == 0) {
+            if (parse_level(term + 6, &config->flush_level) != 0) {
+                DLOG_ERROR_PRINT("Unknown flush level: %s\n", term + 6);
             }
-        } else if (strstr(key, ".log_type")) {
-            if (strcmp(value, "SCREEN") == 0) {
-                *type = OUTPUT_SCREEN;
-            } else if (strcmp(value, "FILE") == 0) {
-                *type = OUTPUT_FILE;
+        } else {
+            DLOG_ERROR_PRINT("Unknown flush policy: %s\n", term);
+        }
+    }
+}
+
+// 输出类型名：log_type 的取值（大小写均可）
+static int parse_output_type(const char* value, log_type* type) {
+    if (strcasecmp(value, "SCREEN") == 0) {
+        *type = OUTPUT_SCREEN;
+    } else if (strcasecmp(value, "FILE") == 0) {
+        *type = OUTPUT_FILE;
+    } else if (strcasecmp(value, "BINARY") == 0) {
+        *type = OUTPUT_BINARY;
+    } else if (strcasecmp(value, "MMAP") == 0) {
+        *type = OUTPUT_MMAP;
+    } else if (strcasecmp(value, "NONE") == 0) {
+        *type = OUTPUT_NONE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static char* trim_spaces(char* str) {
+    while (*str == ' ' || *str == '\t') str++;
+    char* end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *end = '\0';
+    return str;
+}
+
+// 输出端列表：<type>[:<file>][@<LEVEL>]，逗号分隔，如 file:app.log@DEBUG, screen@ERROR
+static void parse_outputs(char* value, const char* name, logger_config_t* config) {
+    config->output_count = 0;
+    char* saveptr = NULL;
+    for (char* term = strtok_r(value, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+        output_config_t output = { OUTPUT_NONE, 0, "" };
+        char* at = strrchr(term, '@');
+        if (at) {
+            *at = '\0';
+            if (parse_level(trim_spaces(at + 1), &output.level) != 0) {
+                DLOG_ERROR_PRINT("Unknown sink level of %s: %s\n", name, at + 1);
             }
-        } else if (strstr(key, ".log_file")) {
-            snprintf(filename, MAX_CONFIG_VALUE_SIZE, "%s", value);
         }
+        char* colon = strchr(term, ':');
+        if (colon) {
+            *colon = '\0';
+            snprintf(output.filename, sizeof(output.filename), "%s", trim_spaces(colon + 1));
+        }
+        if (parse_output_type(trim_spaces(term), &output.type) != 0) {
+            DLOG_ERROR_PRINT("Unknown sink type of %s: %s\n", name, term);
+            continue;
+        }
+        if (config->output_count == MAX_LOGGER_OUTPUTS) {
+            DLOG_ERROR_PRINT("Too many sinks for %s, at most %d are used\n", name, MAX_LOGGER_OUTPUTS);
+            break;
+        }
+        config->outputs[config->output_count++] = output;
+    }
+}
+
+// 解析带单位的大小：如 512K、10M、1G
+static uint64_t parse_size(const char* value) {
+    char* end = NULL;
+    uint64_t size = strtoull(value, &end, 10);
+    switch (end ? *end : '\0') {
+        case 'k': case 'K': return size << 10;
+        case 'm': case 'M': return size << 20;
+        case 'g': case 'G': return size << 30;
+        default:            return size;
+    }
+}
+
+// FNV-1a 哈希
+static uint32_t fnv1a_hash(const char* str) {
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 解析一行 key = value（等号两侧空白可有可无），注释、空行和无效行返回 -1
+static int config_parse_line(char* line, char** key, char** value) {
+    char* p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#') return -1;
+    char* eq = strchr(p, '=');
+    if (!eq) return -1;
+    char* key_end = eq;
+    while (key_end > p && (key_end[-1] == ' ' || key_end[-1] == '\t')) key_end--;
+    *key_end = '\0';
+    char* v = eq + 1;
+    while (*v == ' ' || *v == '\t') v++;
+    char* value_end = v + strlen(v);
+    while (value_end > v && strchr(" \t\r\n", value_end[-1])) value_end--;
+    *value_end = '\0';
+    if (*p == '\0' || *v == '\0') return -1;
+    *key = p;
+    *value = v;
+    return 0;
+}
+
+static void config_table_free(config_table_t* table) {
+    if (!table) return;
+    for (int i = 0; i < CONFIG_HASH_BUCKETS; i++) {
+        config_entry_t* entry = table->buckets[i];
+        while (entry) {
+            config_entry_t* next = entry->next;
+            free(entry->key);
+            free(entry->value);
+            free(entry);
+            entry = next;
+        }
+    }
+    free(table);
+}
+
+static const char* config_table_get(const config_table_t* table, const char* key) {
+    if (!table) return NULL;
+    uint32_t hash = fnv1a_hash(key);
+    for (config_entry_t* entry = table->buckets[hash & (CONFIG_HASH_BUCKETS - 1)]; entry; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry->value;
+        }
+    }
+    return NULL;
+}
+
+// 读取并解析配置文件，同一个键出现多次时以最后一次为准；文件无法打开时返回 NULL
+static config_table_t* config_table_load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return NULL;
+    config_table_t* table = (config_table_t*)calloc(1, sizeof(config_table_t));
+    char buffer[MAX_CONFIG_LINE_SIZE];
+    while (table && fgets(buffer, sizeof(buffer), file) != NULL) {
+        char *key, *value;
+        if (config_parse_line(buffer, &key, &value) != 0) continue;
+        uint32_t hash = fnv1a_hash(key);
+        config_entry_t** bucket = &table->buckets[hash & (CONFIG_HASH_BUCKETS - 1)];
+        config_entry_t* entry = *bucket;
+        while (entry && (entry->hash != hash || strcmp(entry->key, key) != 0)) {
+            entry = entry->next;
+        }
+        char* value_copy = strdup(value);
+        if (!value_copy) continue;
+        if (entry) {
+            free(entry->value);
+            entry->value = value_copy;
+            continue;
+        }
+        entry = (config_entry_t*)malloc(sizeof(config_entry_t));
+        if (!entry || !(entry->key = strdup(key))) {
+            free(entry);
+            free(value_copy);
+            continue;
+        }
+        entry->value = value_copy;
+        entry->hash = hash;
+        entry->next = *bucket;
+        *bucket = entry;
+        table->count++;
     }
-    
     fclose(file);
+    return table;
+}
+
+// 当前生效的配置表：首次使用时加载，dlog_reload 时整体替换；只在注册实例和重新加载时访问，不在日志路径上
+static struct {
+    pthread_mutex_t mutex;
+    config_table_t* table;
+    int loaded;
+} config_ctl = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void config_path_get(char* path, size_t size) {
+    snprintf(path, size, "./%s", LOGGER_CONFIG);
+}
+
+// 加锁并返回当前配置表（可能为 NULL），用完后调用 config_release
+static const config_table_t* config_acquire() {
+    pthread_mutex_lock(&config_ctl.mutex);
+    if (!config_ctl.loaded) {
+        char config_path[DEFAULT_FILEPATH_SIZE];
+        config_path_get(config_path, sizeof(config_path));
+        config_ctl.table = config_table_load(config_path);
+        config_ctl.loaded = 1;
+        if (!config_ctl.table) {
+            DLOG_ERROR_PRINT("Error opening config file: %s\n", config_path);
+        }
+    }
+    return config_ctl.table;
+}
+
+static void config_release() {
+    pthread_mutex_unlock(&config_ctl.mutex);
+}
+
+// 模块配置项 logger.<name>.<option>，模块名须完全匹配
+static const char* config_logger_get(const config_table_t* table, const char* name, const char* option) {
+    char key[MAX_CONFIG_LINE_SIZE];
+    if (snprintf(key, sizeof(key), "logger.%s.%s", name, option) >= (int)sizeof(key)) return NULL;
+    return config_table_get(table, key);
+}
+
+static void logger_config_default(logger_config_t* config) {
+    memset(config, 0, sizeof(*config));
+    config->level = LOG_INFO;
+    config->type = OUTPUT_SCREEN;
+    snprintf(config->filename, sizeof(config->filename), "%s", DEFAULT_LOG_SUFFIX);
+    config->precision = TIME_PRECISION_MS;
+    config->async = ASYNC_LOG;
+    config->writer = -1;
+    config->overflow = OVERFLOW_BLOCK;
+    config->flush_level = LOG_ERROR;
+    config->flush_interval_ms = DLOG_FLUSH_INTERVAL_MS;
+    config->rotate_size = MAX_LOG_FILE_SIZE;
+    config->rotate_time = ROTATE_NONE;
+    config->compress = DLOG_COMPRESS_NONE;
+    config->compress_cpu = DLOG_COMPRESS_CPU_PERCENT;
+}
+
+static int output_to_file(log_type type) {
+    return type == OUTPUT_FILE || type == OUTPUT_BINARY || type == OUTPUT_MMAP;
+}
+
+// 未配置 sinks 时由 log_type / log_file 组成单个输出端；文件类输出未配置文件名时为 <模块名>_<默认后缀>
+static void logger_config_outputs(const char* name, logger_config_t* config) {
+    if (config->output_count == 0) {
+        config->outputs[0].type = config->type;
+        config->outputs[0].level = 0;
+        snprintf(config->outputs[0].filename, sizeof(config->outputs[0].filename), "%s", config->filename);
+        config->output_count = 1;
+    }
+    for (int i = 0; i < config->output_count; i++) {
+        output_config_t* output = &config->outputs[i];
+        if (output_to_file(output->type) && output->filename[0] == '\0') {
+            snprintf(output->filename, sizeof(output->filename), "%s_%s", name, DEFAULT_LOG_SUFFIX);
+        }
+    }
+}
+
+// 用配置表中 logger.<name>.* 的各项覆盖 config 的默认值
+static void logger_config_parse(const config_table_t* table, const char* name, logger_config_t* config) {
+    const char* value;
+    if ((value = config_logger_get(table, name, "log_level")) != NULL) {
+        int level;
+        if (parse_level(value, &level) == 0) {
+            config->level = (log_level)level;
+        }
+    }
+    if ((value = config_logger_get(table, name, "flush")) != NULL) {
+        char policy[MAX_CONFIG_LINE_SIZE];
+        snprintf(policy, sizeof(policy), "%s", value);
+        parse_flush_policy(policy, config);
+    }
+    if ((value = config_logger_get(table, name, "mode")) != NULL) {
+        if (strcmp(value, "async") == 0) {
+            config->async = 1;
+        } else if (strcmp(value, "sync") == 0) {
+            config->async = 0;
+        }
+    }
+    if ((value = config_logger_get(table, name, "overflow")) != NULL) {
+        if (strcmp(value, "block") == 0) {
+            config->overflow = OVERFLOW_BLOCK;
+        } else if (strcmp(value, "drop_new") == 0) {
+            config->overflow = OVERFLOW_DROP_NEW;
+        } else if (strcmp(value, "drop_oldest") == 0) {
+            config->overflow = OVERFLOW_DROP_OLDEST;
+        } else if (strcmp(value, "sync_fallback") == 0) {
+            config->overflow = OVERFLOW_SYNC_FALLBACK;
+        } else {
+            DLOG_ERROR_PRINT("Unknown overflow policy: %s\n", value);
+        }
+    }
+    if ((value = config_logger_get(table, name, "writer")) != NULL) {
+        config->writer = atoi(value);
+    }
+    if ((value = config_logger_get(table, name, "rotate_size")) != NULL) {
+        config->rotate_size = parse_size(value);
+    }
+    if ((value = config_logger_get(table, name, "rotate_time")) != NULL) {
+        if (strcmp(value, "hourly") == 0) {
+            config->rotate_time = ROTATE_HOURLY;
+        } else if (strcmp(value, "daily") == 0) {
+            config->rotate_time = ROTATE_DAILY;
+        } else {
+            config->rotate_time = ROTATE_NONE;
+        }
+    }
+    if ((value = config_logger_get(table, name, "max_files")) != NULL) {
+        config->max_files = atoi(value);
+    }
+    if ((value = config_logger_get(table, name, "flight_recorder")) != NULL) {
+        int entries = atoi(value);
+        config->recorder_entries = entries > 0 ? entries : 0;
+    }
+    if ((value = config_logger_get(table, name, "compress_cpu")) != NULL) {
+        config->compress_cpu = atoi(value);
+    }
+    if ((value = config_logger_get(table, name, "compress")) != NULL) {
+        int compress = DLOG_COMPRESS_NONE;
+        if (strcmp(value, "gzip") == 0) {
+            compress = DLOG_COMPRESS_GZIP;
+        } else if (strcmp(value, "zstd") == 0) {
+            compress = DLOG_COMPRESS_ZSTD;
+        }
+        if (!dlog_compress_supported(compress)) {
+            DLOG_ERROR_PRINT("Compression '%s' not built in, rotated files of %s stay uncompressed\n", value, name);
+            compress = DLOG_COMPRESS_NONE;
+        }
+        config->compress = compress;
+    }
+    if ((value = config_logger_get(table, name, "log_type")) != NULL) {
+        parse_output_type(value, &config->type);
+    }
+    if ((value = config_logger_get(table, name, "log_file")) != NULL) {
+        snprintf(config->filename, MAX_CONFIG_VALUE_SIZE, "%s", value);
+    }
+    if ((value = config_logger_get(table, name, "sinks")) != NULL) {
+        char outputs[MAX_CONFIG_LINE_SIZE];
+        snprintf(outputs, sizeof(outputs), "%s", value);
+        parse_outputs(outputs, name, config);
+    }
+    if ((value = config_logger_get(table, name, "time_precision")) != NULL) {
+        if (strcmp(value, "ms") == 0) {
+            config->precision = TIME_PRECISION_MS;
+        } else if (strcmp(value, "us") == 0) {
+            config->precision = TIME_PRECISION_US;
+        } else if (strcmp(value, "ns") == 0) {
+            config->precision = TIME_PRECISION_NS;
+        }
+    }
+    if ((value = config_logger_get(table, name, "time_format")) != NULL) {
+        if (strcmp(value, "iso8601") == 0) {
+            config->time_style |= TIME_STYLE_ISO8601;
+        } else if (strcmp(value, "default") == 0) {
+            config->time_style &= ~TIME_STYLE_ISO8601;
+        }
+    }
+    if ((value = config_logger_get(table, name, "format_mode")) != NULL) {
+        config->deferred = strcmp(value, "deferred") == 0;
+    }
+    if ((value = config_logger_get(table, name, "format")) != NULL) {
+        if (strcmp(value, "text") == 0) {
+            config->format = DLOG_FORMAT_TEXT;
+        } else if (strcmp(value, "json") == 0) {
+            config->format = DLOG_FORMAT_JSON;
+        } else if (strcmp(value, "logfmt") == 0) {
+            config->format = DLOG_FORMAT_LOGFMT;
+        }
+    }
+    if ((value = config_logger_get(table, name, "time_zone")) != NULL) {
+        if (strcmp(value, "utc") == 0) {
+            config->time_style |= TIME_STYLE_UTC;
+        } else if (strcmp(value, "local") == 0) {
+            config->time_style &= ~TIME_STYLE_UTC;
+        }
+    }
+    logger_config_outputs(name, config);
 }
 
 static const char* get_level_str(uint8_t level) {
@@ -107,21 +741,119 @@ static const char* get_level_str(uint8_t level) {
     }
 }
 
+// 写入文件时使用的等级标签，前后带分隔空格
+#define LEVEL_TAG_LEN 8
+static const char* get_level_tag(uint8_t level) {
+    switch(level) {
+        case LOG_ERROR: return " [ERRO] ";
+        case LOG_WARN:  return " [WARN] ";
+        case LOG_INFO:  return " [INFO] ";
+        case LOG_DEBUG: return " [DEBG] ";
+        case LOG_FATAL: return " [FTAL] ";
+        default:        return " [NONE] ";
+    }
+}
+
 static int is_greater_than_level(logger_t* logger, uint8_t level) {
-    return (uint8_t)logger->level <= level;
+    return __atomic_load_n(&logger->gate.level, __ATOMIC_RELAXED) <= (int)level;
 }
 
-static const char* get_time_string(char* buffer) {
-    struct timeval tv;
-    struct tm tm_info;
+// 当前线程使用的统计分片，首次使用时轮流分配
+static __thread int stats_shard_index = -1;
+static uint32_t stats_shard_next = 0;
 
-    gettimeofday(&tv, NULL);
-    localtime_r(&tv.tv_sec, &tm_info);
+static inline struct logger_stats_shard* logger_stats(logger_t* logger) {
+    if (__builtin_expect(stats_shard_index < 0, 0)) {
+        stats_shard_index = (int)(__atomic_fetch_add(&stats_shard_next, 1, __ATOMIC_RELAXED) % STATS_SHARDS);
+    }
+    return &logger->stats[stats_shard_index];
+}
 
-    strftime(buffer, TIME_STRING_BUFFER_SIZE, TIME_FORMAT, &tm_info);
-    snprintf(buffer + 19, TIME_STRING_BUFFER_SIZE - 19, MILLISECOND_FORMAT, tv.tv_usec / 1000);
+static inline uint64_t stats_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
-    return buffer;
+// 将耗时计入对数直方图
+static inline void stats_histogram_add(uint64_t* histogram, uint64_t ns) {
+    int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    if (bucket >= DLOG_STATS_BUCKETS) bucket = DLOG_STATS_BUCKETS - 1;
+    __atomic_add_fetch(&histogram[bucket], 1, __ATOMIC_RELAXED);
+}
+
+// 记录一条已交给输出端的日志（多个输出端只计一次）
+static inline void logger_stats_message(logger_t* logger, uint8_t level) {
+    if (level >= DLOG_STATS_LEVELS) level = UNKNOWN;
+    __atomic_add_fetch(&logger_stats(logger)->messages[level], 1, __ATOMIC_RELAXED);
+}
+
+// 记录某个输出端写出的字节数
+static inline void logger_stats_bytes(logger_t* logger, uint8_t level, size_t bytes) {
+    if (level >= DLOG_STATS_LEVELS) level = UNKNOWN;
+    __atomic_add_fetch(&logger_stats(logger)->bytes[level], bytes, __ATOMIC_RELAXED);
+}
+
+// 每个线程按样式缓存当前秒的格式化前缀，同一秒内只需补写小数部分
+struct time_cache {
+    time_t sec;
+    int valid;
+    size_t prefix_len;
+    char prefix[TIME_STRING_BUFFER_SIZE];
+    size_t suffix_len;
+    char suffix[8];     // ISO-8601 的时区后缀，如 "Z" 或 "+08:00"
+};
+static __thread struct time_cache time_cache[TIME_STYLE_COUNT];
+
+static void time_cache_refresh(struct time_cache* cache, time_t sec, int style) {
+    struct tm tm_info;
+    if (style & TIME_STYLE_UTC) {
+        gmtime_r(&sec, &tm_info);
+    } else {
+        localtime_r(&sec, &tm_info);
+    }
+    cache->prefix_len = strftime(cache->prefix, sizeof(cache->prefix),
+                                 (style & TIME_STYLE_ISO8601) ? TIME_FORMAT_ISO8601 : TIME_FORMAT, &tm_info);
+    cache->suffix_len = 0;
+    if (style & TIME_STYLE_ISO8601) {
+        if (style & TIME_STYLE_UTC) {
+            cache->suffix[cache->suffix_len++] = 'Z';
+        } else {
+            long offset = tm_info.tm_gmtoff / 60;
+            char sign = offset < 0 ? '-' : '+';
+            if (offset < 0) offset = -offset;
+            cache->suffix_len = (size_t)snprintf(cache->suffix, sizeof(cache->suffix), "%c%02d:%02d",
+                                                 sign, (int)(offset / 60) % 100, (int)(offset % 60));
+        }
+    }
+    cache->sec = sec;
+    cache->valid = 1;
+}
+
+// 将生产者记录的原始时间戳格式化为字符串，返回长度
+static size_t format_time_string(const struct timespec* ts, time_precision precision, int style, char* buffer) {
+    struct time_cache* cache = &time_cache[style & (TIME_STYLE_COUNT - 1)];
+    if (!cache->valid || cache->sec != ts->tv_sec) {
+        time_cache_refresh(cache, ts->tv_sec, style);
+    }
+    char* p = buffer;
+    memcpy(p, cache->prefix, cache->prefix_len);
+    p += cache->prefix_len;
+    // 只补写小数部分
+    long frac = ts->tv_nsec;
+    for (int i = TIME_PRECISION_NS; i > (int)precision; i--) {
+        frac /= 10;
+    }
+    *p++ = '.';
+    for (int i = (int)precision - 1; i >= 0; i--) {
+        p[i] = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    p += precision;
+    memcpy(p, cache->suffix, cache->suffix_len);
+    p += cache->suffix_len;
+    *p = '\0';
+    return (size_t)(p - buffer);
 }
 
 static const char* get_time_string_plain(char* buffer) {
@@ -134,41 +866,52 @@ static const char* get_time_string_plain(char* buffer) {
     return buffer;
 }
 
-static void log_to_file(logger_t* logger, uint8_t level, const char* time_str, const char* message) {
-    if (!logger->file) return;
-    pthread_mutex_lock(&logger->filemutex);
-    fprintf(logger->file, "%s %s %s\n", time_str, get_level_str(level), message);
-    fflush(logger->file);
-    // 日志滚动
-    long pos = ftell(logger->file);
-    if (pos < 0) {
-        DLOG_ERROR_PRINT("Error getting file position for log file: %s\n", logger->filename);
-        pthread_mutex_unlock(&logger->filemutex);
-        return;
-    }
-    if (pos <= MAX_LOG_FILE_SIZE) { // 10MB
-        pthread_mutex_unlock(&logger->filemutex);
-        return;
-    } else {
-        fclose(logger->file);
-        char backup_filename[DEFAULT_FILEPATH_SIZE];
-        char time_str[TIME_STRING_BUFFER_SIZE];
-        get_time_string_plain(time_str);
-        snprintf(backup_filename, sizeof(backup_filename), "%s.%s", logger->filename, time_str);
-        if (rename(logger->filename, backup_filename) != 0) {
-            DLOG_ERROR_PRINT("Failed to rename log file: %s -> %s (errno: %d)\n",
-                    logger->filename, backup_filename, errno);
+// 写出全部 iovec，处理被信号打断和部分写入
+static int log_writev_all(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
         }
-        logger->file = fopen(logger->filename, "a+");
-        if (!logger->file) {
-            DLOG_ERROR_PRINT("Error reopening log file: %s\n", logger->filename);
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
         }
     }
-    pthread_mutex_unlock(&logger->filemutex);
+    return 0;
 }
 
-static void log_to_screen(uint8_t level, const char* time_str, const char* message) {
-    printf("%s %s %s\n", time_str, get_level_str(level), message);
+static int log_to_screen(uint8_t level, const char* time_str, const char* site_str, const char* message) {
+    return printf("%s %s %s%s\n", time_str, get_level_str(level), site_str, message);
+}
+
+// 进程号和线程号各只取一次：线程号缓存在线程局部变量中，fork 后在子进程中重新读取
+static pid_t process_id = 0;
+static __thread pid_t thread_id = 0;
+static pthread_once_t process_id_once = PTHREAD_ONCE_INIT;
+
+static void process_id_reset() {
+    __atomic_store_n(&process_id, getpid(), __ATOMIC_RELAXED);
+    thread_id = 0;
+}
+
+static void process_id_init() {
+    process_id_reset();
+    pthread_atfork(NULL, NULL, process_id_reset);
+}
+
+static inline pid_t current_thread_id() {
+    if (__builtin_expect(thread_id == 0, 0)) {
+        pthread_once(&process_id_once, process_id_init);
+        thread_id = (pid_t)syscall(SYS_gettid);
+    }
+    return thread_id;
 }
 
 struct log_buffer_meta {
@@ -176,246 +919,2058 @@ struct log_buffer_meta {
     int get_count;
     int release_count;
 };
+// 每个缓冲区的预分配空间：时间字符串、调用点前缀和自带的消息空间
+#define LOG_BUFFER_STORAGE_SIZE (TIME_STRING_BUFFER_SIZE + SITE_PREFIX_SIZE + LOG_INLINE_MESSAGE_SIZE)
 struct log_buffer {
     logger_t* logger;
     log_level level;
+    struct timespec ts;     // 生产者记录的原始时间戳，写出时才格式化到 time_str
+    uint64_t enqueue_ns;    // 入队时刻（CLOCK_MONOTONIC），用于统计写出延迟
     char* time_str;
-    char* message;
+    char* message;          // 指向自带的 inline_message，或从消息区借用的整块
+    char* inline_message;
+    uint32_t capacity;      // message 的可用字节数
+    int block_class;        // 借用块所在的大小级别，-1 表示未借用
+    const char* format;     // 延迟格式化时的格式串，此时 message 中保存的是捕获的参数
+    uint32_t args_len;
+    int deferred;
+    const struct dlog_site* site;   // 调用点描述，NULL 表示不输出调用点前缀
+    pid_t tid;                      // 调用线程号，写出时与 site 一起渲染到 site_str
+    char* site_str;
+    // time_str / site_str 已渲染的长度，0 表示尚未渲染：多个输出端共用同一次渲染结果
+    uint16_t time_len;
+    uint16_t site_len;
+    uint64_t journal;       // 崩溃日志环中的记录引用，写出或丢弃后标记完成，0 表示未记录
     struct log_buffer_meta *meta;
+    uint32_t next;  // 全局空闲栈中的下一个缓冲区（池下标 + 1，0 表示栈底）
 };
-// buffer pool lock
-static pthread_mutex_t buffer_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 记录一批日志从入队到交给输出端的延迟
+static void logger_stats_latency(logger_t* logger, struct log_buffer** logs, int count) {
+#if DLOG_STATS_TIMING
+    uint64_t now = stats_now_ns();
+    struct logger_stats_shard* shard = logger_stats(logger);
+    for (int i = 0; i < count; i++) {
+        stats_histogram_add(shard->latency_ns, now > logs[i]->enqueue_ns ? now - logs[i]->enqueue_ns : 0);
+    }
+#else
+    (void)logger;
+    (void)logs;
+    (void)count;
+#endif
+}
+
+// buffer pool：缓冲区在首次使用时一次性分配，之后只在线程缓存和全局无锁空闲栈之间流转
 static struct log_buffer pool[LOG_BUFFER_POOL_SIZE] = {0};
-static volatile int start_index = 0;
-// buffer pool
-struct log_buffer *get_buffer() {
-    pthread_mutex_lock(&buffer_pool_mutex);
-    for (int i = 0; i < LOG_BUFFER_POOL_SIZE; i++){
-        int idx = (start_index + i) % LOG_BUFFER_POOL_SIZE;
-        DLOG_DEBUG_PRINT("Checking buffer index: %d meta: %p\n", idx, pool[idx].meta);
-        if (pool[idx].meta == NULL) {
-            pool[idx].time_str = (char*)malloc(TIME_STRING_BUFFER_SIZE);
-            pool[idx].message = (char*)malloc(MAX_BUFFER);
-            pool[idx].meta = (struct log_buffer_meta*)malloc(sizeof(struct log_buffer_meta));
-            pool[idx].meta->used = 1;
-            pool[idx].meta->get_count = 1;
-            pool[idx].meta->release_count = 0;
-            start_index = (idx + 1) % LOG_BUFFER_POOL_SIZE;
-            pthread_mutex_unlock(&buffer_pool_mutex);
-            DLOG_DEBUG_PRINT("Allocating new buffer at index: %d, %p\n", idx, &pool[idx]);
-            return &pool[idx];
-        } else if (pool[idx].meta->used == 0) {
-            pool[idx].meta->used = 1;
-            pool[idx].meta->get_count += 1;
-            start_index = (idx + 1) % LOG_BUFFER_POOL_SIZE;
-            pthread_mutex_unlock(&buffer_pool_mutex);
-            DLOG_DEBUG_PRINT("Reusing buffer at index: %d, %p\n", idx, &pool[idx]);
-            return &pool[idx];
-        }
-        DLOG_DEBUG_PRINT("Buffer index %d is in use\n", idx);
-    }
-    pthread_mutex_unlock(&buffer_pool_mutex);
-    DLOG_DEBUG_PRINT("Error: All log buffers are in use\n");
-    return NULL;  // 池已满
+static struct log_buffer_meta pool_meta[LOG_BUFFER_POOL_SIZE] = {0};
+// 整个日志内存池（缓冲区自带空间 + 各级消息块）是一块预分配的连续区域
+static char *pool_storage = NULL;
+static size_t pool_storage_size = 0;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+// 全局空闲栈栈顶：高 32 位为版本号（防 ABA），低 32 位为池下标 + 1
+static uint64_t pool_free_head = 0;
+// 不在全局空闲栈中的缓冲区个数及其最大值，只在线程缓存与空闲栈成批交换时更新
+static uint32_t pool_outstanding = 0;
+static uint32_t pool_high_water = 0;
+
+// 线程本地缓存，命中时获取/释放都不需要任何原子操作
+struct log_buffer_cache {
+    struct log_buffer *slots[LOG_BUFFER_CACHE_SIZE];
+    int count;
+    int registered;
+};
+static __thread struct log_buffer_cache buffer_cache = {0};
+static pthread_key_t buffer_cache_key;
+
+// 缓冲区耗尽时等待的线程：有等待者时 release_buffer 直接归还全局空闲栈并唤醒
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int waiters;
+} pool_wait = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+// 将 first..last 已串好的一段缓冲区整体压入全局空闲栈
+static void pool_push_chain(uint32_t first, uint32_t last) {
+    uint64_t old_head = __atomic_load_n(&pool_free_head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    do {
+        __atomic_store_n(&pool[last].next, (uint32_t)old_head, __ATOMIC_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | (first + 1);
+    } while (!__atomic_compare_exchange_n(&pool_free_head, &old_head, new_head, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
-void release_buffer(struct log_buffer *buffer) {
-    pthread_mutex_lock(&buffer_pool_mutex);
-    DLOG_DEBUG_PRINT("Releasing buffer: %p\n", buffer);
-    if (buffer && buffer->meta) {
-        buffer->meta->used = 0;
-        buffer->meta->release_count += 1;
-        buffer->logger = NULL;
-        buffer->level = UNKNOWN;
-        buffer->time_str[0] = '\0';  // 清空数据
-        buffer->message[0] = '\0';  // 清空数据
-    }
-    pthread_mutex_unlock(&buffer_pool_mutex);
+
+static struct log_buffer *pool_pop() {
+    uint64_t old_head = __atomic_load_n(&pool_free_head, __ATOMIC_ACQUIRE);
+    uint64_t new_head;
+    uint32_t idx;
+    do {
+        idx = (uint32_t)old_head;
+        if (idx == 0) return NULL;
+        uint32_t next = __atomic_load_n(&pool[idx - 1].next, __ATOMIC_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | next;
+    } while (!__atomic_compare_exchange_n(&pool_free_head, &old_head, new_head, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    return &pool[idx - 1];
 }
-void log_buffer_debug_info() {
-    pthread_mutex_lock(&buffer_pool_mutex);
-    for (int i = 0; i < LOG_BUFFER_POOL_SIZE; i++){
-        if (pool[i].meta) {
-            if(pool[i].meta->used) {
-                DLOG_DEBUG_PRINT("Buffer %d - in use\n", i);
-            }
-            if(pool[i].meta->get_count != pool[i].meta->release_count) {
-                DLOG_DEBUG_PRINT("Warning: Buffer %d - get_count (%d) != release_count (%d)\n", 
-                        i, pool[i].meta->get_count, pool[i].meta->release_count);
-            }
-        } else {
-            DLOG_DEBUG_PRINT("Buffer %d - uninitialized\n", i);
-        }
+
+// 归还线程缓存中 [from, count) 的缓冲区到全局空闲栈
+static void buffer_cache_spill(struct log_buffer_cache *cache, int from) {
+    if (cache->count <= from) return;
+    for (int i = from; i < cache->count - 1; i++) {
+        cache->slots[i]->next = (uint32_t)(cache->slots[i + 1] - pool) + 1;
     }
-    pthread_mutex_unlock(&buffer_pool_mutex);
+    // 先减计数再归还，避免其他线程先取走这些缓冲区而使计数超过池大小
+    __atomic_sub_fetch(&pool_outstanding, (uint32_t)(cache->count - from), __ATOMIC_RELAXED);
+    pool_push_chain((uint32_t)(cache->slots[from] - pool), (uint32_t)(cache->slots[cache->count - 1] - pool));
+    DLOG_DEBUG_PRINT("Spilled %d buffers to global pool\n", cache->count - from);
+    cache->count = from;
 }
 
-void logger_log_message(struct log_buffer *log) {
-    if (!is_greater_than_level(log->logger, log->level)) {
-        return;
-    }
-    
-    switch (log->logger->type) {
-        case OUTPUT_FILE:
-            log_to_file(log->logger, log->level, log->time_str, log->message);
-            break;
-        case OUTPUT_SCREEN:
-            log_to_screen(log->level, log->time_str, log->message);
-            break;
-        case OUTPUT_NONE:
-            break;
-    }
+// 线程退出时把缓存的缓冲区还给全局空闲栈
+static void buffer_cache_destructor(void *arg) {
+    buffer_cache_spill((struct log_buffer_cache *)arg, 0);
 }
 
-#if (ASYNC_LOG)
-// 日志队列节点
-struct log_queue{
-    struct log_buffer *log;
-    struct log_queue *next;
-    struct log_queue *prev;
+// 消息区：按 1K、2K、4K... 分级，每级是连续区域中固定大小的一组块，空闲块串成带版本号的无锁栈
+#define ARENA_MAX_CLASSES 8
+#define ARENA_MIN_BLOCK_SIZE 1024
+struct arena_class {
+    char *base;
+    uint32_t block_size;
+    uint32_t count;
+    uint32_t *next;         // 空闲栈中下一块的下标 + 1
+    uint64_t free_head;     // 高 32 位为版本号，低 32 位为下标 + 1
 };
-// 日志队列头
-static struct log_queue *log_head = NULL;
-static struct log_queue *log_tail = NULL;
-// 日志队列访问条件变量和互斥锁
-pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
-// 异步线程启动标志
-static volatile int async_thread_started = 0;
-
-// 异步线程
-static pthread_t thread_id;
-void *async_log_thread_func(void* arg) {
-    (void)arg;  // Explicitly mark as unused
-    // 绑定到CPU 0
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(0, &cpuset);
-    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-
-    DLOG_DEBUG_PRINT("Async log thread started\n");
-    while (async_thread_started || log_head->prev != log_tail) {
-        pthread_mutex_lock(&log_mutex);
-        while(log_head->prev == log_tail) {
-            // 队列为空，等待新日志
-            DLOG_DEBUG_PRINT("Async log thread waiting for logs\n");
-            pthread_cond_wait(&log_cond, &log_mutex);
-        }
-        // 取出队列头日志
-        struct log_queue *current = log_head->prev;
-        // 从队列中移除
-        log_head->prev = current->prev;
-        current->prev->next = log_head;
-        pthread_mutex_unlock(&log_mutex);
-        DLOG_DEBUG_PRINT("Processing log: %p\n", current->log);
-        if (current) {
-            logger_log_message(current->log);
-            // 释放日志缓冲区
-            release_buffer(current->log);
-        }
+static struct arena_class arena_classes[ARENA_MAX_CLASSES];
+static int arena_class_count = 0;
+
+static void arena_push(struct arena_class *cls, uint32_t idx) {
+    uint64_t old_head = __atomic_load_n(&cls->free_head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    do {
+        __atomic_store_n(&cls->next[idx], (uint32_t)old_head, __ATOMIC_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | (idx + 1);
+    } while (!__atomic_compare_exchange_n(&cls->free_head, &old_head, new_head, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static int arena_pop(struct arena_class *cls, uint32_t *idx) {
+    uint64_t old_head = __atomic_load_n(&cls->free_head, __ATOMIC_ACQUIRE);
+    uint64_t new_head;
+    do {
+        if ((uint32_t)old_head == 0) return -1;
+        uint32_t next = __atomic_load_n(&cls->next[(uint32_t)old_head - 1], __ATOMIC_RELAXED);
+        new_head = (((old_head >> 32) + 1) << 32) | next;
+    } while (!__atomic_compare_exchange_n(&cls->free_head, &old_head, new_head, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    *idx = (uint32_t)old_head - 1;
+    return 0;
+}
+
+// 借用一块不小于 size 的消息块，无可用块时返回 NULL
+static char *arena_alloc(size_t size, int *class_index) {
+    for (int c = 0; c < arena_class_count; c++) {
+        struct arena_class *cls = &arena_classes[c];
+        uint32_t idx;
+        if (cls->block_size < size || arena_pop(cls, &idx) != 0) continue;
+        *class_index = c;
+        return cls->base + (size_t)idx * cls->block_size;
     }
     return NULL;
 }
-#endif
 
-logger_t* logger_create(const char* logger_name, log_level level, log_type type, const char* filename) {
-    logger_t* log = (logger_t*)malloc(sizeof(logger_t));
-    if (!log) return NULL;
-    
-    log->level = level;
-    log->type = type;
-    
-    if (type == OUTPUT_FILE && (!filename || strlen(filename) == 0)) {
-        char default_filename[DEFAULT_FILEPATH_SIZE];
-        snprintf(default_filename, DEFAULT_FILEPATH_SIZE, "%s_%s", logger_name, DEFAULT_LOG_SUFFIX);
-        log->filename = strdup(default_filename);
-    } else {
-        log->filename = strdup(filename ? filename : "");
-    }
-    if (type == OUTPUT_FILE) {
-        log->file = fopen(log->filename, "a");
-        if (!log->file) {
-            DLOG_ERROR_PRINT("Error opening log file: %s\n", log->filename);
-            free(log->filename);
-            free(log);
-            return NULL;
-        }
-        pthread_mutex_init(&log->filemutex, NULL);
-    } else {
-        log->file = NULL;
+static void arena_free(int class_index, char *block) {
+    struct arena_class *cls = &arena_classes[class_index];
+    arena_push(cls, (uint32_t)((size_t)(block - cls->base) / cls->block_size));
+}
+
+// 让缓冲区改用 block 作为消息空间，归还之前借用的块
+static void log_buffer_set_block(struct log_buffer *buffer, char *block, int class_index) {
+    if (buffer->block_class >= 0) {
+        arena_free(buffer->block_class, buffer->message);
     }
-    return log;
+    buffer->message = block ? block : buffer->inline_message;
+    buffer->capacity = block ? arena_classes[class_index].block_size : LOG_INLINE_MESSAGE_SIZE;
+    buffer->block_class = block ? class_index : -1;
 }
 
+// 把缓冲区的消息空间扩大到至少 size 字节（不超过 MAX_BUFFER），不保留原有内容；无可用块时返回 -1
+static int log_buffer_grow(struct log_buffer *buffer, size_t size) {
+    if (size > MAX_BUFFER) size = MAX_BUFFER;
+    if (size <= buffer->capacity) return 0;
+    int class_index;
+    char *block = arena_alloc(size, &class_index);
+    if (!block) return -1;
+    log_buffer_set_block(buffer, block, class_index);
+    return 0;
+}
 
-void logger_free(logger_t* logger) {
-    if (logger) {
-        free(logger->filename);
-        if (logger->file) {
-            fclose(logger->file);
-            pthread_mutex_destroy(&logger->filemutex);
+// 分配整块内存池：DLOG_ARENA_HUGE_PAGES 时先尝试 MAP_HUGETLB，失败则用普通页并建议透明大页
+static char *arena_map(size_t *size) {
+    char *region = MAP_FAILED;
+#if DLOG_ARENA_HUGE_PAGES
+    size_t huge_size = (*size + (2u << 20) - 1) & ~(size_t)((2u << 20) - 1);
+    region = (char*)mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (region != MAP_FAILED) {
+        *size = huge_size;
+        return region;
+    }
+#endif
+    region = (char*)mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return NULL;
+#if DLOG_ARENA_HUGE_PAGES
+    madvise(region, *size, MADV_HUGEPAGE);
+#endif
+    return region;
+}
+
+static void buffer_pool_init() {
+    // 规划各级消息块：从 ARENA_MIN_BLOCK_SIZE 起每级 2 倍，最后一级为 MAX_BUFFER
+    size_t header_bytes = (size_t)LOG_BUFFER_POOL_SIZE * LOG_BUFFER_STORAGE_SIZE;
+    size_t total = header_bytes;
+    size_t next_bytes = 0;
+    arena_class_count = 0;
+    for (size_t block = ARENA_MIN_BLOCK_SIZE; arena_class_count < ARENA_MAX_CLASSES; block *= 2) {
+        if (block > MAX_BUFFER || arena_class_count == ARENA_MAX_CLASSES - 1) block = MAX_BUFFER;
+        struct arena_class *cls = &arena_classes[arena_class_count++];
+        cls->block_size = (uint32_t)block;
+        cls->count = LOG_ARENA_CLASS_BYTES / block ? (uint32_t)(LOG_ARENA_CLASS_BYTES / block) : 1;
+        total += (size_t)cls->count * block;
+        next_bytes += (size_t)cls->count * sizeof(uint32_t);
+        if (block == MAX_BUFFER) break;
+    }
+    total += next_bytes;
+
+    pool_storage = arena_map(&total);
+    if (!pool_storage) {
+        DLOG_ERROR_PRINT("Error allocating log buffer pool\n");
+        return;
+    }
+    pool_storage_size = total;
+    pthread_key_create(&buffer_cache_key, buffer_cache_destructor);
+    for (int i = 0; i < LOG_BUFFER_POOL_SIZE; i++) {
+        char *storage = pool_storage + (size_t)i * LOG_BUFFER_STORAGE_SIZE;
+        pool[i].time_str = storage;
+        pool[i].site_str = storage + TIME_STRING_BUFFER_SIZE;
+        pool[i].inline_message = pool[i].site_str + SITE_PREFIX_SIZE;
+        pool[i].message = pool[i].inline_message;
+        pool[i].capacity = LOG_INLINE_MESSAGE_SIZE;
+        pool[i].block_class = -1;
+        pool[i].time_str[0] = '\0';
+        pool[i].message[0] = '\0';
+        pool[i].meta = &pool_meta[i];
+        pool[i].next = (i + 1 < LOG_BUFFER_POOL_SIZE) ? (uint32_t)(i + 2) : 0;
+    }
+    char *cursor = pool_storage + header_bytes;
+    for (int c = 0; c < arena_class_count; c++) {
+        struct arena_class *cls = &arena_classes[c];
+        cls->base = cursor;
+        cursor += (size_t)cls->count * cls->block_size;
+    }
+    for (int c = 0; c < arena_class_count; c++) {
+        struct arena_class *cls = &arena_classes[c];
+        cls->next = (uint32_t*)cursor;
+        cursor += (size_t)cls->count * sizeof(uint32_t);
+        for (uint32_t i = 0; i < cls->count; i++) {
+            cls->next[i] = (i + 1 < cls->count) ? i + 2 : 0;
+        }
+        __atomic_store_n(&cls->free_head, (uint64_t)1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&pool_free_head, (uint64_t)1, __ATOMIC_RELEASE);
+}
+
+// buffer pool
+struct log_buffer *get_buffer() {
+    struct log_buffer_cache *cache = &buffer_cache;
+    if (cache->count == 0) {
+        // 本地缓存为空，从全局空闲栈批量取回一半
+        pthread_once(&pool_once, buffer_pool_init);
+        if (!cache->registered && pool_storage) {
+            pthread_setspecific(buffer_cache_key, cache);
+            cache->registered = 1;
+        }
+        struct log_buffer *buffer;
+        while (cache->count < LOG_BUFFER_CACHE_SIZE / 2 && (buffer = pool_pop()) != NULL) {
+            cache->slots[cache->count++] = buffer;
+        }
+        if (cache->count == 0) {
+            DLOG_DEBUG_PRINT("Error: All log buffers are in use\n");
+            return NULL;  // 池已满
+        }
+        uint32_t outstanding = __atomic_add_fetch(&pool_outstanding, (uint32_t)cache->count, __ATOMIC_RELAXED);
+        uint32_t high_water = __atomic_load_n(&pool_high_water, __ATOMIC_RELAXED);
+        while (outstanding > high_water &&
+               !__atomic_compare_exchange_n(&pool_high_water, &high_water, outstanding, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+    struct log_buffer *buffer = cache->slots[--cache->count];
+    buffer->meta->used = 1;
+    __atomic_fetch_add(&buffer->meta->get_count, 1, __ATOMIC_RELAXED);
+    DLOG_DEBUG_PRINT("Get buffer: %p\n", buffer);
+    return buffer;
+}
+void release_buffer(struct log_buffer *buffer) {
+    DLOG_DEBUG_PRINT("Releasing buffer: %p\n", buffer);
+    if (!buffer || !buffer->meta) return;
+    buffer->meta->used = 0;
+    __atomic_fetch_add(&buffer->meta->release_count, 1, __ATOMIC_RELAXED);
+    buffer->logger = NULL;
+    buffer->level = UNKNOWN;
+    log_buffer_set_block(buffer, NULL, -1);  // 归还借用的消息块
+    buffer->time_str[0] = '\0';  // 清空数据
+    buffer->message[0] = '\0';  // 清空数据
+    if (buffer->journal) {
+        dlog_journal_done(buffer->journal);
+        buffer->journal = 0;
+    }
+
+    struct log_buffer_cache *cache = &buffer_cache;
+    if (cache->count == LOG_BUFFER_CACHE_SIZE) {
+        // 本地缓存已满（异步模式下的消费线程），归还一半给全局空闲栈
+        buffer_cache_spill(cache, LOG_BUFFER_CACHE_SIZE / 2);
+    }
+    if (!cache->registered) {
+        pthread_setspecific(buffer_cache_key, cache);
+        cache->registered = 1;
+    }
+    cache->slots[cache->count++] = buffer;
+    // 有线程在等待缓冲区：连同本地缓存一起归还全局空闲栈，不让缓冲区滞留在写出线程的缓存中
+    if (__atomic_load_n(&pool_wait.waiters, __ATOMIC_SEQ_CST)) {
+        buffer_cache_spill(cache, 0);
+        pthread_mutex_lock(&pool_wait.mutex);
+        pthread_cond_broadcast(&pool_wait.cond);
+        pthread_mutex_unlock(&pool_wait.mutex);
+    }
+}
+
+// 阻塞直到取得缓冲区；登记等待后再取一次，限时等待兜底归还发生在登记之前的情况
+static struct log_buffer *get_buffer_wait() {
+    struct log_buffer *buffer;
+    pthread_mutex_lock(&pool_wait.mutex);
+    __atomic_add_fetch(&pool_wait.waiters, 1, __ATOMIC_SEQ_CST);
+    while ((buffer = get_buffer()) == NULL && pool_storage) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += DLOG_BG_TICK_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool_wait.cond, &pool_wait.mutex, &deadline);
+    }
+    __atomic_sub_fetch(&pool_wait.waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool_wait.mutex);
+    return buffer;
+}
+// 阻塞直到借到不小于 size 的消息块，等待方式同 get_buffer_wait
+static int log_buffer_grow_wait(struct log_buffer *buffer, size_t size) {
+    int ret;
+    pthread_mutex_lock(&pool_wait.mutex);
+    __atomic_add_fetch(&pool_wait.waiters, 1, __ATOMIC_SEQ_CST);
+    while ((ret = log_buffer_grow(buffer, size)) != 0 && pool_storage) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += DLOG_BG_TICK_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool_wait.cond, &pool_wait.mutex, &deadline);
+    }
+    __atomic_sub_fetch(&pool_wait.waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool_wait.mutex);
+    return ret;
+}
+
+void log_buffer_debug_info() {
+    for (int i = 0; i < LOG_BUFFER_POOL_SIZE; i++){
+        if (pool[i].meta) {
+            if(pool[i].meta->used) {
+                DLOG_DEBUG_PRINT("Buffer %d - in use\n", i);
+            }
+            if(pool[i].meta->get_count != pool[i].meta->release_count) {
+                DLOG_DEBUG_PRINT("Warning: Buffer %d - get_count (%d) != release_count (%d)\n", 
+                        i, pool[i].meta->get_count, pool[i].meta->release_count);
+            }
+        } else {
+            DLOG_DEBUG_PRINT("Buffer %d - uninitialized\n", i);
+        }
+    }
+}
+
+// 一条日志最多对应的 iovec 数：文本为时间、等级标签、调用点前缀、消息、换行；
+// json / logfmt 另有行首；二进制为格式串定义头、格式串、条目头、参数
+#define LOG_IOV_PER_MSG 6
+static size_t log_buffer_format_time(struct log_buffer *log) {
+    if (!log->time_len) {
+        log->time_len = (uint16_t)format_time_string(&log->ts, log->logger->precision, log->logger->time_style,
+                                                     log->time_str);
+    }
+    return log->time_len;
+}
+
+// 由调用点描述渲染前缀，在写出线程中执行，调用线程只记录描述指针和线程号
+static size_t log_buffer_format_site(struct log_buffer *log) {
+    if (!log->site) {
+        log->site_str[0] = '\0';
+        return 0;
+    }
+    if (log->site_len) return log->site_len;
+    int pid = (int)__atomic_load_n(&process_id, __ATOMIC_RELAXED);
+    int len;
+    if (log->logger->format == DLOG_FORMAT_TEXT) {
+        len = snprintf(log->site_str, SITE_PREFIX_SIZE, "<%d,%d,%s,%s,%d> ",
+                       pid, (int)log->tid, log->site->file, log->site->func, log->site->line);
+    } else {
+        len = dlog_kv_site(log->site_str, SITE_PREFIX_SIZE, log->logger->format,
+                           pid, (int)log->tid, log->site->file, log->site->func, log->site->line);
+    }
+    log->site_len = (uint16_t)(len < 0 ? 0 : (len < SITE_PREFIX_SIZE ? len : SITE_PREFIX_SIZE - 1));
+    return log->site_len;
+}
+
+// 延迟格式化的渲染先写到栈上，放不下时再借用更大的消息块
+#define RENDER_STACK_SIZE 4096
+
+// 将延迟格式化的消息渲染为文本
+static void log_buffer_render(struct log_buffer *log) {
+    if (!log->deferred) return;
+    log->deferred = 0;
+    char local[RENDER_STACK_SIZE];
+    int written = dlog_fmt_render(local, sizeof(local), log->format, log->message, log->args_len);
+    if (written < 0) {
+        DLOG_ERROR_PRINT("Error: deferred format failed\n");
+        snprintf(log->message, log->capacity, "%s", LOG_FORMAT_ERROR_MSG);
+        return;
+    }
+    if ((size_t)written < sizeof(local) && (uint32_t)written < log->capacity) {
+        memcpy(log->message, local, (size_t)written + 1);
+        return;
+    }
+    // 放不下：借用新块，从仍保存在 message 中的参数直接渲染到新块
+    int class_index;
+    char *block = arena_alloc((size_t)written + 1 < MAX_BUFFER ? (size_t)written + 1 : MAX_BUFFER, &class_index);
+    if (block) {
+        written = dlog_fmt_render(block, arena_classes[class_index].block_size, log->format, log->message, log->args_len);
+        log_buffer_set_block(log, block, class_index);
+    } else {
+        snprintf(log->message, log->capacity, "%s", local);
+    }
+    if ((uint32_t)written >= log->capacity) {
+        __atomic_add_fetch(&logger_stats(log->logger)->truncated, 1, __ATOMIC_RELAXED);
+        DLOG_ERROR_PRINT(TRUNCATION_WARNING_MSG, (long)written);
+    }
+}
+
+// 查找格式串 id，首次出现时分配新 id 并返回 1（需要先写出定义）
+static int log_sink_format_id(log_sink *sink, const char *format, uint32_t *id) {
+    if (sink->format_id_count * 2 >= sink->format_id_capacity) {
+        uint32_t capacity = sink->format_id_capacity ? sink->format_id_capacity * 2 : 64;
+        format_id_slot *slots = (format_id_slot*)calloc(capacity, sizeof(format_id_slot));
+        if (!slots) return -1;
+        for (uint32_t i = 0; i < sink->format_id_capacity; i++) {
+            format_id_slot *old = &sink->format_ids[i];
+            if (!old->format) continue;
+            uint32_t idx = (uint32_t)(((uintptr_t)old->format >> 3) * 2654435761u) & (capacity - 1);
+            while (slots[idx].format) idx = (idx + 1) & (capacity - 1);
+            slots[idx] = *old;
+        }
+        free(sink->format_ids);
+        sink->format_ids = slots;
+        sink->format_id_capacity = capacity;
+    }
+    uint32_t mask = sink->format_id_capacity - 1;
+    uint32_t idx = (uint32_t)(((uintptr_t)format >> 3) * 2654435761u) & mask;
+    while (sink->format_ids[idx].format) {
+        if (sink->format_ids[idx].format == format) {
+            *id = sink->format_ids[idx].id;
+            return 0;
+        }
+        idx = (idx + 1) & mask;
+    }
+    sink->format_ids[idx].format = format;
+    sink->format_ids[idx].id = sink->format_id_count++;
+    *id = sink->format_ids[idx].id;
+    return 1;
+}
+
+// 二进制记录：记录头写在 time_str 中（二进制日志不需要格式化时间），其他输出端需要时重新格式化时间
+static int log_buffer_binary_iov(log_sink *sink, struct log_buffer *log, struct iovec *iov) {
+    int iovcnt = 0;
+    char *head = log->time_str;
+    log->time_len = 0;
+    int64_t sec = (int64_t)log->ts.tv_sec;
+    uint32_t nsec = (uint32_t)log->ts.tv_nsec;
+    uint32_t id = 0;
+    // 调用方持有 sink 的 filemutex
+    int is_new = log->deferred ? log_sink_format_id(sink, log->format, &id) : 0;
+    if (is_new < 0) {
+        log_buffer_render(log);
+    } else if (is_new > 0) {
+        uint32_t format_len = (uint32_t)strlen(log->format);
+        head[0] = DLOG_BIN_FORMAT;
+        memcpy(head + 1, &id, 4);
+        memcpy(head + 5, &format_len, 4);
+        iov[iovcnt].iov_base = head;
+        iov[iovcnt++].iov_len = DLOG_BIN_FORMAT_HEAD_LEN;
+        iov[iovcnt].iov_base = (void*)log->format;
+        iov[iovcnt++].iov_len = format_len;
+        head += DLOG_BIN_FORMAT_HEAD_LEN;
+    }
+    head[1] = (char)log->level;
+    memcpy(head + 2, &sec, 8);
+    memcpy(head + 10, &nsec, 4);
+    if (log->deferred) {
+        head[0] = DLOG_BIN_ENTRY;
+        memcpy(head + 14, &id, 4);
+        memcpy(head + 18, &log->args_len, 4);
+        iov[iovcnt].iov_base = head;
+        iov[iovcnt++].iov_len = DLOG_BIN_ENTRY_HEAD_LEN;
+        iov[iovcnt].iov_base = log->message;
+        iov[iovcnt++].iov_len = log->args_len;
+    } else {
+        uint32_t len = (uint32_t)strlen(log->message);
+        head[0] = DLOG_BIN_TEXT;
+        memcpy(head + 14, &len, 4);
+        iov[iovcnt].iov_base = head;
+        iov[iovcnt++].iov_len = DLOG_BIN_TEXT_HEAD_LEN;
+        iov[iovcnt].iov_base = log->message;
+        iov[iovcnt++].iov_len = len;
+    }
+    return iovcnt;
+}
+
+// 文本类记录（二进制记录由 log_buffer_binary_iov 生成）
+static int log_buffer_iov(logger_t *logger, struct log_buffer *log, struct iovec *iov) {
+    log_buffer_render(log);
+    int iovcnt = 0;
+    int json = (logger->format == DLOG_FORMAT_JSON);
+    int level = log->level < DLOG_STATS_LEVELS ? log->level : UNKNOWN;
+    if (logger->format != DLOG_FORMAT_TEXT) {
+        iov[iovcnt].iov_base = (void*)(json ? "{\"time\":\"" : "time=\"");
+        iov[iovcnt++].iov_len = json ? 9 : 6;
+    }
+    iov[iovcnt].iov_base = log->time_str;
+    iov[iovcnt++].iov_len = log_buffer_format_time(log);
+    if (logger->format != DLOG_FORMAT_TEXT) {
+        iov[iovcnt].iov_base = (void*)logger->level_head[level];
+        iov[iovcnt++].iov_len = logger->level_head_len[level];
+    } else {
+        iov[iovcnt].iov_base = (void*)get_level_tag(log->level);
+        iov[iovcnt++].iov_len = LEVEL_TAG_LEN;
+    }
+    if (log->site) {
+        iov[iovcnt].iov_base = log->site_str;
+        iov[iovcnt++].iov_len = log_buffer_format_site(log);
+    }
+    iov[iovcnt].iov_base = log->message;
+    iov[iovcnt++].iov_len = strlen(log->message);
+    iov[iovcnt].iov_base = (void*)(json ? "}\n" : "\n");
+    iov[iovcnt++].iov_len = json ? 2 : 1;
+    return iovcnt;
+}
+
+// 映射段 k；该段对应的槽位仍被更早的段占用时返回 1。
+// 出错时返回 -1，槽位仍登记为段 k（base 为 NULL），写满后照常释放，不会卡住之后使用该槽位的段
+static int mmap_sink_map(mmap_sink* sink, uint64_t k) {
+    mmap_slot* slot = &sink->slots[k % MMAP_SEGMENT_SLOTS];
+    int ret = 0;
+    pthread_mutex_lock(&sink->map_mutex);
+    uint64_t index = __atomic_load_n(&slot->index, __ATOMIC_ACQUIRE);
+    if (index == k) goto out;
+    if (index != MMAP_SLOT_EMPTY) {
+        ret = 1;
+        goto out;
+    }
+    off_t offset = (off_t)(k * DLOG_MMAP_SEGMENT_SIZE);
+    char* base = NULL;
+    // 预分配磁盘空间，避免写映射区时因磁盘满收到 SIGBUS；只有文件系统不支持时才退化为扩展文件长度，
+    // 磁盘已满等其他错误按映射失败处理
+    if (fallocate(sink->fd, 0, offset, DLOG_MMAP_SEGMENT_SIZE) != 0 &&
+        ((errno != EOPNOTSUPP && errno != ENOSYS) || ftruncate(sink->fd, offset + DLOG_MMAP_SEGMENT_SIZE) != 0)) {
+        ret = -1;
+    } else {
+        base = (char*)mmap(NULL, DLOG_MMAP_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, sink->fd, offset);
+        if (base == MAP_FAILED) {
+            base = NULL;
+            ret = -1;
+        }
+    }
+    if (ret < 0) {
+        DLOG_ERROR_PRINT("Error mapping log segment %lu, its logs are dropped (errno: %d)\n", (unsigned long)k, errno);
+    }
+    slot->base = base;
+    // 续写已有文件时，首段中已有的数据视为已写完
+    slot->committed = (k == sink->start / DLOG_MMAP_SEGMENT_SIZE) ? sink->start % DLOG_MMAP_SEGMENT_SIZE : 0;
+    __atomic_store_n(&slot->index, k, __ATOMIC_RELEASE);
+out:
+    pthread_mutex_unlock(&sink->map_mutex);
+    return ret;
+}
+
+// 取段 k 的映射地址；通常已由后台线程提前映射，写入线程不会进入系统调用
+static char* mmap_sink_segment(mmap_sink* sink, uint64_t k) {
+    mmap_slot* slot = &sink->slots[k % MMAP_SEGMENT_SLOTS];
+    while (__atomic_load_n(&slot->index, __ATOMIC_ACQUIRE) != k) {
+        if (mmap_sink_map(sink, k) > 0) sched_yield();
+    }
+    return slot->base;
+}
+
+static mmap_sink* mmap_sink_open(const char* filename) {
+    mmap_sink* sink = (mmap_sink*)calloc(1, sizeof(mmap_sink));
+    if (!sink) return NULL;
+    sink->fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, LOG_FILE_MODE);
+    struct stat st;
+    if (sink->fd < 0 || fstat(sink->fd, &st) != 0) {
+        if (sink->fd >= 0) close(sink->fd);
+        free(sink);
+        return NULL;
+    }
+    sink->start = (uint64_t)st.st_size;
+    sink->pos = sink->start;
+    for (int i = 0; i < MMAP_SEGMENT_SLOTS; i++) {
+        sink->slots[i].index = MMAP_SLOT_EMPTY;
+    }
+    pthread_mutex_init(&sink->map_mutex, NULL);
+    mmap_sink_map(sink, sink->start / DLOG_MMAP_SEGMENT_SIZE);
+    return sink;
+}
+
+// 后台线程提前映射下一段，使写入线程跨段时无需等待 fallocate/mmap
+static void mmap_sink_prepare(mmap_sink* sink) {
+    uint64_t k = __atomic_load_n(&sink->pos, __ATOMIC_RELAXED) / DLOG_MMAP_SEGMENT_SIZE;
+    mmap_sink_map(sink, k);
+    mmap_sink_map(sink, k + 1);
+}
+
+// 预留 len 字节并拷贝 iov，返回预留的起始偏移
+static uint64_t mmap_sink_write(mmap_sink* sink, const struct iovec* iov, int iovcnt, size_t len) {
+    uint64_t offset = __atomic_fetch_add(&sink->pos, len, __ATOMIC_RELAXED);
+    uint64_t cur = offset;
+    size_t left = len;
+    int i = 0;
+    size_t iov_off = 0;
+    while (left > 0) {
+        uint64_t k = cur / DLOG_MMAP_SEGMENT_SIZE;
+        size_t seg_off = (size_t)(cur % DLOG_MMAP_SEGMENT_SIZE);
+        size_t n = DLOG_MMAP_SEGMENT_SIZE - seg_off;
+        if (n > left) n = left;
+        char* base = mmap_sink_segment(sink, k);
+        // 将 iov 中接下来的 n 字节拷入本段；映射失败时丢弃这部分数据
+        for (size_t copied = 0; copied < n && i < iovcnt; ) {
+            size_t chunk = iov[i].iov_len - iov_off;
+            if (chunk > n - copied) chunk = n - copied;
+            if (base) memcpy(base + seg_off + copied, (const char*)iov[i].iov_base + iov_off, chunk);
+            copied += chunk;
+            iov_off += chunk;
+            if (iov_off == iov[i].iov_len) {
+                i++;
+                iov_off = 0;
+            }
+        }
+        // 映射失败的段同样计入，写满后释放槽位
+        mmap_slot* slot = &sink->slots[k % MMAP_SEGMENT_SLOTS];
+        if (__atomic_add_fetch(&slot->committed, n, __ATOMIC_ACQ_REL) == DLOG_MMAP_SEGMENT_SIZE) {
+            if (base) munmap(base, DLOG_MMAP_SEGMENT_SIZE);
+            __atomic_store_n(&slot->index, MMAP_SLOT_EMPTY, __ATOMIC_RELEASE);
+        }
+        cur += n;
+        left -= n;
+    }
+    return offset;
+}
+
+// 关闭前调用方需保证没有写入线程仍在使用：解除全部映射，并把文件截断到实际写入的长度
+static void mmap_sink_close(mmap_sink* sink) {
+    for (int i = 0; i < MMAP_SEGMENT_SLOTS; i++) {
+        if (sink->slots[i].index != MMAP_SLOT_EMPTY && sink->slots[i].base) {
+            munmap(sink->slots[i].base, DLOG_MMAP_SEGMENT_SIZE);
+        }
+    }
+    if (ftruncate(sink->fd, (off_t)sink->pos) != 0) {
+        DLOG_ERROR_PRINT("Error truncating mmap log file (errno: %d)\n", errno);
+    }
+    close(sink->fd);
+    pthread_mutex_destroy(&sink->map_mutex);
+    free(sink);
+}
+
+// 新文件就绪后的准备：按文件现有大小初始化字节计数；空的二进制日志文件先写入文件头，并清空格式串 id 表
+static void log_file_prepare(log_sink *sink, int fd) {
+    struct stat st;
+    uint64_t size = fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    if (sink->type == OUTPUT_BINARY) {
+        sink->format_id_count = 0;
+        if (sink->format_ids) {
+            memset(sink->format_ids, 0, sizeof(format_id_slot) * sink->format_id_capacity);
+        }
+        if (size == 0) {
+            if (write(fd, DLOG_BIN_MAGIC, DLOG_BIN_MAGIC_LEN) != DLOG_BIN_MAGIC_LEN) {
+                DLOG_ERROR_PRINT("Error writing binary log header: %s\n", sink->filename);
+            } else {
+                size = DLOG_BIN_MAGIC_LEN;
+            }
+        }
+    }
+    __atomic_store_n(&sink->file_bytes, size, __ATOMIC_RELAXED);
+}
+
+// 计算下一次按时间滚动的时刻（本地时间的整点或零点）
+static time_t log_file_next_rotate_at(int rotate_time, time_t now) {
+    if (rotate_time == ROTATE_NONE) return 0;
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    tm_info.tm_sec = 0;
+    tm_info.tm_min = 0;
+    if (rotate_time == ROTATE_HOURLY) {
+        tm_info.tm_hour += 1;
+    } else {
+        tm_info.tm_hour = 0;
+        tm_info.tm_mday += 1;
+    }
+    tm_info.tm_isdst = -1;
+    return mktime(&tm_info);
+}
+
+static int log_file_open(log_sink *sink) {
+    if (sink->type == OUTPUT_MMAP) {
+        mmap_sink* map = mmap_sink_open(sink->filename);
+        if (!map) return -1;
+        __atomic_store_n(&sink->mmap, map, __ATOMIC_RELEASE);
+        // 续写的文件已超过滚动大小时，由后台线程先滚动一次
+        if (sink->rotate_size && map->start > sink->rotate_size) {
+            sink->rotate_pending = 1;
+        }
+        __atomic_store_n(&sink->fd, map->fd, __ATOMIC_RELEASE);
+    } else {
+        // 追加写缓冲在首次打开时分配，文件关闭后保留到退出（内存映射输出不需要）
+        if (!sink->write_buf && !(sink->write_buf = (char*)malloc(LOG_WRITE_BUFFER_SIZE))) return -1;
+        int fd = open(sink->filename, LOG_FILE_OPEN_FLAGS, LOG_FILE_MODE);
+        if (fd < 0) return -1;
+        log_file_prepare(sink, fd);
+        sink->write_len = 0;
+        __atomic_store_n(&sink->fd, fd, __ATOMIC_RELEASE);
+    }
+    sink->next_rotate_at = log_file_next_rotate_at(sink->rotate_time, time(NULL));
+    return 0;
+}
+
+// 文件当前长度（含未落盘的缓冲数据）
+static uint64_t log_file_size(log_sink *sink) {
+    if (sink->type == OUTPUT_MMAP) {
+        return __atomic_load_n(&sink->mmap->pos, __ATOMIC_RELAXED);
+    }
+    return __atomic_load_n(&sink->file_bytes, __ATOMIC_RELAXED) +
+           __atomic_load_n(&sink->write_len, __ATOMIC_RELAXED);
+}
+
+static uint64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// 滚动文件名是否已被占用：原文件、压缩后的文件及其中间文件都算，避免同一秒内的滚动覆盖已压缩的文件
+static int log_file_backup_taken(const char* backup_filename) {
+    static const dlog_compress_type types[] = { DLOG_COMPRESS_GZIP, DLOG_COMPRESS_ZSTD };
+    char path[PATH_MAX + 16];
+    if (access(backup_filename, F_OK) == 0) return 1;
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        const char* suffix = dlog_compress_suffix(types[i]);
+        snprintf(path, sizeof(path), "%s%s", backup_filename, suffix);
+        if (access(path, F_OK) == 0) return 1;
+        snprintf(path, sizeof(path), "%s%s%s", backup_filename, suffix, DLOG_COMPRESS_TMP_SUFFIX);
+        if (access(path, F_OK) == 0) return 1;
+    }
+    return 0;
+}
+
+// 生成滚动文件名：<file>.<时间>.<序号>，序号保证同一秒内多次滚动也不会覆盖；
+// 文件名放不下或同一秒内的序号用尽时返回 -1，不截断成可能重复的文件名
+static int log_file_backup_name(const char* filename, char* backup_filename, size_t size) {
+    char time_str[TIME_STRING_BUFFER_SIZE];
+    get_time_string_plain(time_str);
+    for (int seq = 1; seq <= LOG_BACKUP_SEQ_MAX; seq++) {
+        int len = snprintf(backup_filename, size, "%s.%s.%03d", filename, time_str, seq);
+        if (len < 0 || (size_t)len >= size) return -1;
+        if (!log_file_backup_taken(backup_filename)) return 0;
+    }
+    return -1;
+}
+
+static int backup_name_compare(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 按文件名（时间+序号）排序，只保留最新的 max_files 个滚动文件
+static void log_file_cleanup(const char* filename, int max_files) {
+    if (max_files <= 0) return;
+    char dir_path[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "%s", filename);
+    char* slash = strrchr(dir_path, '/');
+    const char* base = slash ? strrchr(filename, '/') + 1 : filename;
+    if (slash) {
+        *slash = '\0';
+    } else {
+        snprintf(dir_path, sizeof(dir_path), ".");
+    }
+    size_t base_len = strlen(base);
+
+    DIR* dir = opendir(dir_path);
+    if (!dir) return;
+    char** names = NULL;
+    int count = 0, capacity = 0;
+    struct dirent* dent;
+    size_t tmp_len = strlen(DLOG_COMPRESS_TMP_SUFFIX);
+    while ((dent = readdir(dir)) != NULL) {
+        // 只匹配 <file>.<YYYYmmdd_HHMMSS>... 形式的滚动文件（含压缩后的文件），跳过压缩中间文件
+        size_t len = strlen(dent->d_name);
+        if (strncmp(dent->d_name, base, base_len) != 0 || dent->d_name[base_len] != '.' ||
+            dent->d_name[base_len + 1] < '0' || dent->d_name[base_len + 1] > '9' ||
+            (len > tmp_len && strcmp(dent->d_name + len - tmp_len, DLOG_COMPRESS_TMP_SUFFIX) == 0)) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char** grown = (char**)realloc(names, sizeof(char*) * capacity);
+            if (!grown) break;
+            names = grown;
+        }
+        names[count++] = strdup(dent->d_name);
+    }
+    closedir(dir);
+
+    qsort(names, count, sizeof(char*), backup_name_compare);
+    for (int i = 0; i < count; i++) {
+        if (i < count - max_files) {
+            char path[PATH_MAX + NAME_MAX + 2];
+            snprintf(path, sizeof(path), "%s/%s", dir_path, names[i]);
+            // 压缩线程可能同时删除了同名原文件
+            if (unlink(path) != 0 && errno != ENOENT) {
+                DLOG_ERROR_PRINT("Failed to remove old log file: %s (errno: %d)\n", path, errno);
+            }
+        }
+        free(names[i]);
+    }
+    free(names);
+}
+
+// 通知后台线程执行滚动，每次滚动只通知一次
+static void log_file_request_rotate(log_sink* sink) {
+    if (__atomic_exchange_n(&sink->rotate_pending, 1, __ATOMIC_ACQ_REL)) return;
+    pthread_mutex_lock(&bg_ctl.mutex);
+    pthread_cond_signal(&bg_ctl.cond);
+    pthread_mutex_unlock(&bg_ctl.mutex);
+}
+
+// 缓冲区中的数据与 iov[1..iovcnt) 一起一次 writev 写出，iov[0] 由本函数填写
+static void log_file_write_locked(log_sink* sink, struct iovec* iov, int iovcnt) {
+    if (sink->fd < 0) return;
+    iov[0].iov_base = sink->write_buf;
+    iov[0].iov_len = sink->write_len;
+    uint64_t bytes = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        bytes += iov[i].iov_len;
+    }
+    if (log_writev_all(sink->fd, iov, iovcnt) != 0) {
+        DLOG_ERROR_PRINT("Error writing log file: %s (errno: %d)\n", sink->filename, errno);
+    }
+    __atomic_store_n(&sink->write_len, 0, __ATOMIC_RELAXED);
+    // 用内存中的字节计数判断是否需要滚动，不再调用 ftell/lseek
+    uint64_t file_bytes = sink->file_bytes + bytes;
+    __atomic_store_n(&sink->file_bytes, file_bytes, __ATOMIC_RELAXED);
+    if (sink->rotate_size && file_bytes > sink->rotate_size) {
+        log_file_request_rotate(sink);
+    }
+}
+
+static void *compress_thread_func(void* arg) {
+    (void)arg;
+    // 只使用空闲 CPU，不与写日志的线程竞争；不支持 SCHED_IDLE 时退化为最低 nice 值
+    struct sched_param param = { .sched_priority = 0 };
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        setpriority(PRIO_PROCESS, (id_t)gettid(), 19);
+    }
+    pthread_mutex_lock(&compress_ctl.mutex);
+    while (!compress_ctl.stopping) {
+        compress_job* job = compress_ctl.head;
+        if (!job) {
+            pthread_cond_wait(&compress_ctl.cond, &compress_ctl.mutex);
+            continue;
+        }
+        compress_ctl.head = job->next;
+        if (!compress_ctl.head) compress_ctl.tail = NULL;
+        pthread_mutex_unlock(&compress_ctl.mutex);
+
+        log_sink* sink = job->sink;
+        if (dlog_compress_file(job->path, sink->compress, sink->compress_cpu, &compress_ctl.stopping) == 0) {
+            log_file_cleanup(job->filename, __atomic_load_n(&sink->max_files, __ATOMIC_RELAXED));
+        }
+        free(job);
+        pthread_mutex_lock(&compress_ctl.mutex);
+    }
+    pthread_mutex_unlock(&compress_ctl.mutex);
+    return NULL;
+}
+
+static void compress_thread_start() {
+    compress_ctl.running = 1;
+    if (pthread_create(&compress_ctl.thread, NULL, compress_thread_func, NULL) != 0) {
+        DLOG_ERROR_PRINT("Error creating log compression thread\n");
+        compress_ctl.running = 0;
+    }
+}
+
+// 把滚动后的文件交给压缩线程
+static void compress_submit(log_sink* sink, const char* path) {
+    pthread_once(&compress_thread_once, compress_thread_start);
+    if (!compress_ctl.running) return;
+    compress_job* job = (compress_job*)malloc(sizeof(compress_job));
+    if (!job) return;
+    job->next = NULL;
+    job->sink = sink;
+    if ((size_t)snprintf(job->path, sizeof(job->path), "%s", path) >= sizeof(job->path) ||
+        (size_t)snprintf(job->filename, sizeof(job->filename), "%s", sink->filename) >= sizeof(job->filename)) {
+        DLOG_ERROR_PRINT("Log file path too long, %s stays uncompressed\n", path);
+        free(job);
+        return;
+    }
+    pthread_mutex_lock(&compress_ctl.mutex);
+    if (compress_ctl.tail) {
+        compress_ctl.tail->next = job;
+    } else {
+        compress_ctl.head = job;
+    }
+    compress_ctl.tail = job;
+    pthread_cond_signal(&compress_ctl.cond);
+    pthread_mutex_unlock(&compress_ctl.mutex);
+}
+
+// 未完成的压缩任务直接丢弃，对应的滚动文件保持未压缩
+static void compress_thread_stop() {
+    pthread_mutex_lock(&compress_ctl.mutex);
+    __atomic_store_n(&compress_ctl.stopping, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&compress_ctl.cond);
+    pthread_mutex_unlock(&compress_ctl.mutex);
+    if (compress_ctl.running) {
+        pthread_join(compress_ctl.thread, NULL);
+        compress_ctl.running = 0;
+    }
+    while (compress_ctl.head) {
+        compress_job* job = compress_ctl.head;
+        compress_ctl.head = job->next;
+        free(job);
+    }
+    compress_ctl.tail = NULL;
+}
+
+// 写入线程先登记再确认 mmap 仍在使用，替换后等登记数归零即可确认没有线程还在写旧映射
+static void mmap_writers_wait(log_sink* sink) {
+    while (__atomic_load_n(&sink->mmap_writers, __ATOMIC_SEQ_CST) != 0) {
+        sched_yield();
+    }
+}
+
+// 打开同名新文件替换当前输出文件（仅后台线程调用）：打开不持锁，只在交换描述符时短暂持有 filemutex
+static int log_file_reopen(log_sink* sink) {
+    if (sink->type == OUTPUT_MMAP) {
+        mmap_sink* map = mmap_sink_open(sink->filename);
+        if (!map) return -1;
+        mmap_sink* old_map = __atomic_exchange_n(&sink->mmap, map, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&sink->fd, map->fd, __ATOMIC_RELAXED);
+        mmap_writers_wait(sink);
+        mmap_sink_close(old_map);
+    } else {
+        int new_fd = open(sink->filename, LOG_FILE_OPEN_FLAGS, LOG_FILE_MODE);
+        if (new_fd < 0) return -1;
+
+        struct iovec iov[1];
+        pthread_mutex_lock(&sink->filemutex);
+        // 缓冲中的数据属于旧文件
+        if (sink->write_len) {
+            log_file_write_locked(sink, iov, 1);
+        }
+        int old_fd = __atomic_exchange_n(&sink->fd, new_fd, __ATOMIC_ACQ_REL);
+        log_file_prepare(sink, new_fd);
+        pthread_mutex_unlock(&sink->filemutex);
+        close(old_fd);
+    }
+    return 0;
+}
+
+// 日志滚动（仅后台线程调用）：先改名，再打开同名新文件替换
+static void log_file_rotate(log_sink* sink) {
+    char backup_filename[PATH_MAX];
+    if (log_file_backup_name(sink->filename, backup_filename, sizeof(backup_filename)) != 0) {
+        DLOG_ERROR_PRINT("No usable rotated file name for %s, rotation skipped\n", sink->filename);
+        __atomic_store_n(&sink->rotate_pending, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    if (rename(sink->filename, backup_filename) != 0) {
+        DLOG_ERROR_PRINT("Failed to rename log file: %s -> %s (errno: %d)\n",
+                sink->filename, backup_filename, errno);
+        __atomic_store_n(&sink->rotate_pending, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    int ret = log_file_reopen(sink);
+    __atomic_store_n(&sink->rotate_pending, 0, __ATOMIC_RELEASE);
+    if (ret != 0) {
+        DLOG_ERROR_PRINT("Error reopening log file: %s\n", sink->filename);
+        return;
+    }
+
+    __atomic_add_fetch(&sink->rotations, 1, __ATOMIC_RELAXED);
+    sink->next_rotate_at = log_file_next_rotate_at(sink->rotate_time, time(NULL));
+    log_file_cleanup(sink->filename, sink->max_files);
+    if (sink->compress != DLOG_COMPRESS_NONE) {
+        compress_submit(sink, backup_filename);
+    }
+}
+
+// 将缓冲区落盘
+static void log_file_flush(log_sink* sink) {
+    if (sink->fd < 0 || !__atomic_load_n(&sink->write_len, __ATOMIC_RELAXED)) return;
+    struct iovec iov[1];
+    pthread_mutex_lock(&sink->filemutex);
+    if (sink->write_len) {
+        log_file_write_locked(sink, iov, 1);
+    }
+    pthread_mutex_unlock(&sink->filemutex);
+}
+
+// 锁住输出端当前的输出文件：输出端刚切换到其他文件且旧文件已关闭时改用新文件
+static log_sink* log_sink_lock(log_sink** sink_ref) {
+    for (;;) {
+        log_sink* sink = __atomic_load_n(sink_ref, __ATOMIC_ACQUIRE);
+        pthread_mutex_lock(&sink->filemutex);
+        if (sink->fd >= 0 || __atomic_load_n(sink_ref, __ATOMIC_ACQUIRE) == sink) return sink;
+        pthread_mutex_unlock(&sink->filemutex);
+    }
+}
+
+// 写出同一输出文件的一条或多条日志（可来自共享该文件的不同实例），sink_ref 为第一条日志所用输出端的文件：
+// 按落盘策略追加到缓冲区，或连同缓冲区一次 writev 写出。iov 需至少有 count * LOG_IOV_PER_MSG + 1 个元素
+static void log_to_file(log_sink** sink_ref, struct log_buffer** logs, int count, struct iovec* iov) {
+    log_sink* sink = log_sink_lock(sink_ref);
+    if (sink->fd < 0) {
+        pthread_mutex_unlock(&sink->filemutex);
+        return;
+    }
+    int iovcnt = 1;
+    size_t bytes = 0;
+    size_t flush_bytes = 0;
+    int flush_now = 0;
+    for (int i = 0; i < count; i++) {
+        logger_t* logger = logs[i]->logger;
+        int n = sink->type == OUTPUT_BINARY ? log_buffer_binary_iov(sink, logs[i], iov + iovcnt)
+                                            : log_buffer_iov(logger, logs[i], iov + iovcnt);
+        size_t msg_bytes = 0;
+        for (int k = 0; k < n; k++) {
+            msg_bytes += iov[iovcnt + k].iov_len;
+        }
+        logger_stats_bytes(logger, logs[i]->level, msg_bytes);
+        bytes += msg_bytes;
+        iovcnt += n;
+        // 落盘策略按实例生效，同一批中任一实例要求落盘即整批落盘
+        // 记入崩溃日志环的日志写出后即标记完成，需要整批直接写入文件
+        if (logger->flush_always || logs[i]->journal ||
+            (logger->flush_level && (int)logs[i]->level >= logger->flush_level)) {
+            flush_now = 1;
+        }
+        if (logger->flush_bytes && (!flush_bytes || logger->flush_bytes < flush_bytes)) {
+            flush_bytes = logger->flush_bytes;
+        }
+    }
+    if (sink->write_len + bytes > LOG_WRITE_BUFFER_SIZE ||
+        (flush_bytes && sink->write_len + bytes >= flush_bytes)) {
+        flush_now = 1;
+    }
+    if (flush_now) {
+        log_file_write_locked(sink, iov, iovcnt);
+    } else {
+        if (sink->write_len == 0) {
+            sink->pending_since_ms = monotonic_ms();
+        }
+        size_t len = sink->write_len;
+        for (int i = 1; i < iovcnt; i++) {
+            memcpy(sink->write_buf + len, iov[i].iov_base, iov[i].iov_len);
+            len += iov[i].iov_len;
+        }
+        __atomic_store_n(&sink->write_len, len, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&sink->filemutex);
+}
+
+// 写入内存映射文件：无锁、无系统调用，多个线程可同时拷贝
+static void log_to_mmap(struct logger_output* output, struct log_buffer* log) {
+    struct iovec iov[LOG_IOV_PER_MSG];
+    int iovcnt = log_buffer_iov(log->logger, log, iov);
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    // 登记后确认输出端仍在使用该文件，关闭文件时会等待登记数归零
+    log_sink* sink;
+    for (;;) {
+        sink = __atomic_load_n(&output->sink, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&sink->mmap_writers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&output->sink, __ATOMIC_SEQ_CST) == sink) break;
+        __atomic_sub_fetch(&sink->mmap_writers, 1, __ATOMIC_RELEASE);
+    }
+    mmap_sink* map = __atomic_load_n(&sink->mmap, __ATOMIC_SEQ_CST);
+    uint64_t offset = map ? mmap_sink_write(map, iov, iovcnt, len) : 0;
+    __atomic_sub_fetch(&sink->mmap_writers, 1, __ATOMIC_RELEASE);
+    logger_stats_bytes(log->logger, log->level, len);
+    // 只有跨过滚动大小的那条日志负责通知后台线程
+    uint64_t rotate_size = sink->rotate_size;
+    if (map && rotate_size && offset <= rotate_size && offset + len > rotate_size) {
+        log_file_request_rotate(sink);
+    }
+}
+
+// 规范化路径：目录部分取 realpath，使同一文件的不同写法（如 ./a.log 与 a.log）对应同一个 sink；
+// 结果放不下时返回 -1，不截断成可能与其他文件相同的键
+static int log_sink_path(const char* filename, char* out, size_t size) {
+    char dir[PATH_MAX];
+    char resolved[PATH_MAX];
+    const char* slash = strrchr(filename, '/');
+    const char* base = slash ? slash + 1 : filename;
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash == filename) {
+        snprintf(dir, sizeof(dir), "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - filename), filename);
+    }
+    int len;
+    if (realpath(dir, resolved)) {
+        len = snprintf(out, size, "%s%s%s", resolved, strcmp(resolved, "/") == 0 ? "" : "/", base);
+    } else {
+        len = snprintf(out, size, "%s", filename);
+    }
+    return len < 0 || (size_t)len >= size ? -1 : 0;
+}
+
+// 滚动与压缩配置：同一文件的各实例共用，重新加载时以最后应用的实例配置为准
+static void log_sink_policy(log_sink* sink, const logger_config_t* config) {
+    __atomic_store_n(&sink->rotate_size, config->rotate_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&sink->max_files, config->max_files, __ATOMIC_RELAXED);
+    __atomic_store_n(&sink->compress, config->compress, __ATOMIC_RELAXED);
+    __atomic_store_n(&sink->compress_cpu, config->compress_cpu, __ATOMIC_RELAXED);
+    if (__atomic_exchange_n(&sink->rotate_time, config->rotate_time, __ATOMIC_RELAXED) != config->rotate_time) {
+        __atomic_store_n(&sink->reschedule_rotate, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static int log_sink_policy_equal(const log_sink* sink, const logger_config_t* config) {
+    return sink->rotate_size == config->rotate_size && sink->rotate_time == config->rotate_time &&
+           sink->max_files == config->max_files && sink->compress == config->compress &&
+           sink->compress_cpu == config->compress_cpu;
+}
+
+// 关闭输出文件，缓冲数据先落盘；sink 本身保留，之后可被重新打开。调用方持有 sink_ctl.mutex
+static void log_sink_close(log_sink* sink) {
+    if (sink->fd < 0) return;
+    if (sink->type == OUTPUT_MMAP) {
+        mmap_sink* map = __atomic_exchange_n(&sink->mmap, NULL, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&sink->fd, -1, __ATOMIC_RELEASE);
+        mmap_writers_wait(sink);
+        mmap_sink_close(map);
+    } else {
+        struct iovec iov[1];
+        pthread_mutex_lock(&sink->filemutex);
+        if (sink->write_len) {
+            log_file_write_locked(sink, iov, 1);
+        }
+        close(sink->fd);
+        __atomic_store_n(&sink->fd, -1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&sink->filemutex);
+    }
+    __atomic_store_n(&sink->rotate_pending, 0, __ATOMIC_RELEASE);
+}
+
+// 取得 filename 对应的共享输出文件（引用计数加一），尚未打开时按 config 的滚动配置打开
+static log_sink* log_sink_acquire(const char* filename, log_type type, const char* logger_name,
+                                  const logger_config_t* config) {
+    char path[PATH_MAX];
+    if (log_sink_path(filename, path, sizeof(path)) != 0) {
+        DLOG_ERROR_PRINT("%s: log file path too long: %s\n", logger_name, filename);
+        return NULL;
+    }
+    pthread_mutex_lock(&sink_ctl.mutex);
+    log_sink* sink = sink_ctl.all;
+    while (sink && strcmp(sink->path, path) != 0) {
+        sink = sink->next;
+    }
+    if (sink && sink->type != type) {
+        DLOG_ERROR_PRINT("%s: log file %s is already used with another log_type\n", logger_name, filename);
+        sink = NULL;
+    } else if (sink && sink->fd >= 0) {
+        if (!log_sink_policy_equal(sink, config)) {
+            DLOG_ERROR_PRINT("%s: rotation settings differ from other modules sharing %s, keeping the current ones\n",
+                    logger_name, filename);
+        }
+        sink->refs++;
+    } else if (sink) {
+        // 所有实例都已离开的文件，重新打开
+        log_sink_policy(sink, config);
+        if (log_file_open(sink) == 0) {
+            sink->refs++;
+        } else {
+            DLOG_ERROR_PRINT("Error opening log file: %s\n", filename);
+            sink = NULL;
+        }
+    } else if ((sink = (log_sink*)calloc(1, sizeof(log_sink))) != NULL) {
+        sink->filename = strdup(filename);
+        sink->path = strdup(path);
+        sink->type = type;
+        sink->fd = -1;
+        log_sink_policy(sink, config);
+        sink->reschedule_rotate = 0;
+        if (!sink->filename || !sink->path || log_file_open(sink) != 0) {
+            DLOG_ERROR_PRINT("Error opening log file: %s\n", filename);
+            free(sink->filename);
+            free(sink->path);
+            free(sink->write_buf);
+            free(sink);
+            sink = NULL;
+        } else {
+            pthread_mutex_init(&sink->filemutex, NULL);
+            sink->refs = 1;
+            sink->next = sink_ctl.all;
+            sink_ctl.all = sink;
+        }
+    }
+    pthread_mutex_unlock(&sink_ctl.mutex);
+    return sink;
+}
+
+// 引用计数减一，没有实例使用时关闭文件
+static void log_sink_release(log_sink* sink) {
+    pthread_mutex_lock(&sink_ctl.mutex);
+    if (--sink->refs == 0) {
+        log_sink_close(sink);
+    }
+    pthread_mutex_unlock(&sink_ctl.mutex);
+}
+
+// 退出时关闭并释放所有输出文件
+static void log_sink_ctl_free() {
+    pthread_mutex_lock(&sink_ctl.mutex);
+    log_sink* sink = sink_ctl.all;
+    while (sink) {
+        log_sink* next = sink->next;
+        log_sink_close(sink);
+        pthread_mutex_destroy(&sink->filemutex);
+        free(sink->filename);
+        free(sink->path);
+        free(sink->write_buf);
+        free(sink->format_ids);
+        free(sink);
+        sink = next;
+    }
+    sink_ctl.all = NULL;
+    pthread_mutex_unlock(&sink_ctl.mutex);
+}
+
+// 接收该等级日志的输出端位图
+static uint32_t logger_output_mask(logger_t* logger, uint8_t level) {
+    uint32_t mask = 0;
+    for (int k = 0; k < logger->output_count; k++) {
+        if (__atomic_load_n(&logger->outputs[k].level, __ATOMIC_RELAXED) <= (int)level) {
+            mask |= 1u << k;
+        }
+    }
+    return mask;
+}
+
+// 交给一个输出端；iov 需至少有 LOG_IOV_PER_MSG + 1 个元素
+static void logger_output_write(struct logger_output* output, struct log_buffer* log, struct iovec* iov) {
+    switch (output->type) {
+        case OUTPUT_FILE:
+        case OUTPUT_BINARY:
+            log_to_file(&output->sink, &log, 1, iov);
+            break;
+        case OUTPUT_MMAP:
+            log_to_mmap(output, log);
+            break;
+        case OUTPUT_SCREEN: {
+            int printed;
+            if (log->logger->format != DLOG_FORMAT_TEXT) {
+                int iovcnt = log_buffer_iov(log->logger, log, iov);
+                printed = 0;
+                flockfile(stdout);
+                for (int i = 0; i < iovcnt; i++) {
+                    printed += (int)fwrite_unlocked(iov[i].iov_base, 1, iov[i].iov_len, stdout);
+                }
+                funlockfile(stdout);
+            } else {
+                log_buffer_render(log);
+                log_buffer_format_time(log);
+                log_buffer_format_site(log);
+                printed = log_to_screen(log->level, log->time_str, log->site_str, log->message);
+            }
+            logger_stats_bytes(log->logger, log->level, printed > 0 ? (size_t)printed : 0);
+            break;
+        }
+        case OUTPUT_NONE:
+            break;
+    }
+}
+
+void logger_log_message(struct log_buffer *log) {
+    struct iovec iov[LOG_IOV_PER_MSG + 1];
+    logger_t *logger = log->logger;
+    uint32_t mask = logger_output_mask(logger, log->level);
+    while (mask) {
+        int k = __builtin_ctz(mask);
+        mask &= mask - 1;
+        logger_output_write(&logger->outputs[k], log, iov);
+    }
+    logger_stats_message(logger, log->level);
+    logger_stats_latency(logger, &log, 1);
+}
+
+// 日志队列：预分配的有界多生产者单消费者环形队列，每个槽位独占一个缓存行
+struct log_queue_slot {
+    uint64_t sequence;          // 槽位序号：等于入队位置时可写，等于入队位置+1时可读，等于入队位置+2时已被生产者取走
+    struct log_buffer *log;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// 异步写出线程：每个线程独占一个队列，每个异步实例固定分配给其中一个线程，保证同一文件内的顺序
+struct async_writer {
+    struct log_queue_slot queue[ASYNC_QUEUE_SIZE];
+    // 生产者共享的入队位置，与消费者私有的出队位置分属不同缓存行
+    uint64_t enqueue_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint64_t dequeue_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint64_t processed;         // 消费者已写出（或跳过被取走的槽位）的条数，供 fflush_async_log 等待
+    uint32_t high_water;        // 消费者每批取出前看到的最大队列深度
+    int consumer_sleeping __attribute__((aligned(CACHE_LINE_SIZE)));
+    int wakeup_fd;              // eventfd，仅在消费者休眠时由生产者写入
+    int running;
+    int index;
+    pthread_t thread;
+    // 消费线程私有的批处理缓冲
+    struct log_buffer *batch[ASYNC_BATCH_SIZE];
+    struct log_buffer *group[ASYNC_BATCH_SIZE];
+    uint32_t pending[ASYNC_BATCH_SIZE];
+    struct iovec iov[ASYNC_BATCH_SIZE * LOG_IOV_PER_MSG + 1];
+};
+
+// 写出线程池配置，来自配置文件中的 dlog.* 全局项
+typedef struct {
+    int threads;
+    int cpus[DLOG_MAX_WRITER_THREADS];  // 第 i 个线程绑定到 cpus[i % cpu_count]
+    int cpu_count;                      // 0 表示不绑核
+    char name[16];                      // 线程名前缀（最长 12 个字符），线程名为 <name>-<序号>
+} writer_config_t;
+
+static struct {
+    struct async_writer *writers;
+    int count;
+    int ok;
+    uint32_t next;              // 轮流分配写出线程
+} async_ctl;
+static pthread_once_t async_thread_once = PTHREAD_ONCE_INIT;
+
+static void log_queue_wakeup(struct async_writer *writer) {
+    uint64_t one = 1;
+    if (write(writer->wakeup_fd, &one, sizeof(one)) < 0) {
+        DLOG_ERROR_PRINT("Error waking async log thread (errno: %d)\n", errno);
+    }
+}
+
+// 入队：一次 CAS 占位，队列满时返回 -1
+static int log_queue_push(struct async_writer *writer, struct log_buffer *log) {
+    uint64_t pos = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_RELAXED);
+    struct log_queue_slot *slot;
+    for (;;) {
+        slot = &writer->queue[pos & (ASYNC_QUEUE_SIZE - 1)];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&writer->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;  // 队列已满
+        } else {
+            pos = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&slot->log, log, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    // 与消费者的休眠标志构成 Dekker 同步：只有消费者确实在休眠时才进行系统调用
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&writer->consumer_sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&writer->consumer_sleeping, 0, __ATOMIC_ACQ_REL)) {
+        log_queue_wakeup(writer);
+    }
+    return 0;
+}
+
+// 出队：仅由所属的写出线程调用，跳过已被生产者取走的槽位，队列为空时返回 NULL
+static struct log_buffer *log_queue_pop(struct async_writer *writer) {
+    for (;;) {
+        uint64_t pos = writer->dequeue_pos;
+        struct log_queue_slot *slot = &writer->queue[pos & (ASYNC_QUEUE_SIZE - 1)];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        struct log_buffer *log = NULL;
+        if (seq == pos + 1) {
+            log = slot->log;
+            // 与 log_queue_steal 竞争同一槽位，失败说明刚被取走
+            if (!__atomic_compare_exchange_n(&slot->sequence, &seq, pos + ASYNC_QUEUE_SIZE, 0,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+        } else if (seq == pos + 2) {
+            __atomic_store_n(&slot->sequence, pos + ASYNC_QUEUE_SIZE, __ATOMIC_RELEASE);
+            // 被取走的日志已计入 dropped，这里计入已处理，否则 fflush_async_log 永远等不到入队位置
+            __atomic_store_n(&writer->processed, writer->processed + 1, __ATOMIC_RELEASE);
+        } else {
+            return NULL;
+        }
+        __atomic_store_n(&writer->dequeue_pos, pos + 1, __ATOMIC_RELAXED);
+        if (log) return log;
+    }
+}
+
+static int log_queue_empty(struct async_writer *writer) {
+    uint64_t pos = writer->dequeue_pos;
+    uint64_t seq = __atomic_load_n(&writer->queue[pos & (ASYNC_QUEUE_SIZE - 1)].sequence, __ATOMIC_ACQUIRE);
+    return seq != pos + 1 && seq != pos + 2;
+}
+
+// 供 drop_oldest 的生产者调用：取走队列中 logger 最早的一条日志（写出线程出队时跳过该槽位），没有时返回 NULL。
+// 槽位序号单调递增，序号仍为 pos+1 时 CAS 成功即保证取走的正是检查过的那条日志
+static struct log_buffer *log_queue_steal(struct async_writer *writer, logger_t *logger) {
+    uint64_t pos = __atomic_load_n(&writer->dequeue_pos, __ATOMIC_RELAXED);
+    uint64_t end = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_RELAXED);
+    for (; pos < end; pos++) {
+        struct log_queue_slot *slot = &writer->queue[pos & (ASYNC_QUEUE_SIZE - 1)];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (seq != pos + 1) continue;   // 已出队、已被取走或尚未写好
+        struct log_buffer *log = __atomic_load_n(&slot->log, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&log->logger, __ATOMIC_RELAXED) != logger) continue;
+        if (__atomic_compare_exchange_n(&slot->sequence, &seq, pos + 2, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return log;
+        }
+    }
+    return NULL;
+}
+
+// 将一批日志按输出文件分组：每个文件整批只做一次 writev，组内保持入队顺序
+static void async_log_write_batch(struct async_writer *writer, int count) {
+    struct log_buffer **batch = writer->batch;
+    // 每条日志待写的输出端位图；写一个文件输出端时，后续日志中写往同一文件的输出端合并为一组，同一文件内保持入队顺序
+    uint32_t *pending = writer->pending;
+    for (int i = 0; i < count; i++) {
+        if (batch[i]) pending[i] = logger_output_mask(batch[i]->logger, batch[i]->level);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!batch[i]) continue;
+        logger_t *logger = batch[i]->logger;
+        while (pending[i]) {
+            struct logger_output *output = &logger->outputs[__builtin_ctz(pending[i])];
+            pending[i] &= pending[i] - 1;
+            if (output->type != OUTPUT_FILE && output->type != OUTPUT_BINARY) {
+                logger_output_write(output, batch[i], writer->iov);
+                continue;
+            }
+            log_sink *sink = __atomic_load_n(&output->sink, __ATOMIC_ACQUIRE);
+            int group = 0;
+            writer->group[group++] = batch[i];
+            for (int j = i + 1; j < count; j++) {
+                if (!batch[j]) continue;
+                struct logger_output *outputs = batch[j]->logger->outputs;
+                for (uint32_t mask = pending[j]; mask; mask &= mask - 1) {
+                    int k = __builtin_ctz(mask);
+                    if (__atomic_load_n(&outputs[k].sink, __ATOMIC_ACQUIRE) == sink) {
+                        pending[j] &= ~(1u << k);
+                        writer->group[group++] = batch[j];
+                        break;
+                    }
+                }
+            }
+            log_to_file(&output->sink, writer->group, group, writer->iov);
+        }
+        logger_stats_message(logger, batch[i]->level);
+        logger_stats_latency(logger, &batch[i], 1);
+        release_buffer(batch[i]);
+        batch[i] = NULL;
+    }
+}
+
+// 异步写出线程
+static void *async_log_thread_func(void* arg) {
+    struct async_writer *writer = (struct async_writer*)arg;
+    DLOG_DEBUG_PRINT("Async log thread %d started\n", writer->index);
+    for (;;) {
+        // 一次取出队列中所有待写日志（最多 ASYNC_BATCH_SIZE 条）
+        int count = 0;
+        int lingered = 0;
+        uint64_t depth = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_RELAXED) - writer->dequeue_pos;
+        if (depth > writer->high_water) {
+            __atomic_store_n(&writer->high_water, (uint32_t)depth, __ATOMIC_RELAXED);
+        }
+        for (;;) {
+            struct log_buffer *log;
+            while (count < ASYNC_BATCH_SIZE && (log = log_queue_pop(writer)) != NULL) {
+                writer->batch[count++] = log;
+            }
+            // 批次未满时最多额外等待 ASYNC_BATCH_LATENCY_MS 以凑成更大的批次
+            if (count == 0 || count == ASYNC_BATCH_SIZE || lingered || ASYNC_BATCH_LATENCY_MS <= 0 ||
+                !__atomic_load_n(&writer->running, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            usleep(ASYNC_BATCH_LATENCY_MS * 1000);
+            lingered = 1;
+        }
+        if (count > 0) {
+            DLOG_DEBUG_PRINT("Processing %d logs\n", count);
+            async_log_write_batch(writer, count);
+            __atomic_store_n(&writer->processed, writer->processed + count, __ATOMIC_RELEASE);
+            dlog_journal_reclaim();
+            continue;
+        }
+        if (!__atomic_load_n(&writer->running, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        // 队列为空：先声明休眠再复查一次，避免丢失唤醒
+        __atomic_store_n(&writer->consumer_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (log_queue_empty(writer) && __atomic_load_n(&writer->running, __ATOMIC_ACQUIRE)) {
+            DLOG_DEBUG_PRINT("Async log thread %d waiting for logs\n", writer->index);
+            uint64_t wakeups;
+            if (read(writer->wakeup_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EINTR) {
+                DLOG_ERROR_PRINT("Error waiting for logs (errno: %d)\n", errno);
+            }
+        }
+        __atomic_store_n(&writer->consumer_sleeping, 0, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+// 解析 CPU 列表：如 "2,3" 或 "4-7"，"none" 表示不绑核
+static void parse_cpu_list(const char* value, writer_config_t* config) {
+    config->cpu_count = 0;
+    if (strcmp(value, "none") == 0) return;
+    const char* p = value;
+    while (*p && config->cpu_count < DLOG_MAX_WRITER_THREADS) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && config->cpu_count < DLOG_MAX_WRITER_THREADS; cpu++) {
+            config->cpus[config->cpu_count++] = (int)cpu;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+}
+
+// 读取写出线程池的全局配置：dlog.writer_threads / dlog.writer_affinity / dlog.writer_name
+static void writer_config_load(writer_config_t* config) {
+    const config_table_t* table = config_acquire();
+    const char* value;
+    if ((value = config_table_get(table, "dlog.writer_threads")) != NULL) {
+        config->threads = atoi(value);
+    }
+    if ((value = config_table_get(table, "dlog.writer_affinity")) != NULL) {
+        parse_cpu_list(value, config);
+    }
+    if ((value = config_table_get(table, "dlog.writer_name")) != NULL) {
+        // 线程名最长 15 个字符，留出 "-<序号>" 的位置
+        snprintf(config->name, sizeof(config->name), "%.12s", value);
+    }
+    config_release();
+    if (config->threads < 1) config->threads = 1;
+    if (config->threads > DLOG_MAX_WRITER_THREADS) config->threads = DLOG_MAX_WRITER_THREADS;
+}
+
+// 崩溃日志环：配置了 dlog.crash_journal 时在启动写出线程前打开，上次运行残留的日志先补写到各自的文件
+static void journal_config_load() {
+    const config_table_t* table = config_acquire();
+    const char* path = config_table_get(table, "dlog.crash_journal");
+    if (path) {
+        const char* value = config_table_get(table, "dlog.crash_journal_size");
+        if (dlog_journal_open(path, value ? parse_size(value) : DLOG_JOURNAL_SIZE) == 0) {
+            value = config_table_get(table, "dlog.crash_handler");
+            if (!value || !(strcmp(value, "off") == 0 || strcmp(value, "false") == 0 || strcmp(value, "0") == 0)) {
+                dlog_journal_install_handler();
+            }
+        }
+    }
+    config_release();
+}
+
+static void async_thread_start() {
+    writer_config_t config = {
+        .threads = DLOG_WRITER_THREADS,
+        .cpu_count = 0,
+        .name = "dlog-writer",
+    };
+    writer_config_load(&config);
+    journal_config_load();
+
+    struct async_writer *writers = NULL;
+    if (posix_memalign((void**)&writers, CACHE_LINE_SIZE, sizeof(struct async_writer) * config.threads) != 0) {
+        DLOG_ERROR_PRINT("Error allocating async log writers\n");
+        return;
+    }
+    memset(writers, 0, sizeof(struct async_writer) * config.threads);
+    async_ctl.writers = writers;
+    for (int w = 0; w < config.threads; w++) {
+        struct async_writer *writer = &writers[w];
+        // 初始化队列
+        for (uint64_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+            writer->queue[i].sequence = i;
+        }
+        writer->index = w;
+        writer->wakeup_fd = eventfd(0, EFD_CLOEXEC);
+        if (writer->wakeup_fd < 0) {
+            DLOG_ERROR_PRINT("Error creating eventfd (errno: %d)\n", errno);
+            break;
+        }
+        writer->running = 1;
+        if (pthread_create(&writer->thread, NULL, async_log_thread_func, writer) != 0) {
+            DLOG_ERROR_PRINT("Error creating async log thread\n");
+            writer->running = 0;
+            close(writer->wakeup_fd);
+            break;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%s-%d", config.name, w);
+        pthread_setname_np(writer->thread, name);
+        if (config.cpu_count > 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(config.cpus[w % config.cpu_count], &cpuset);
+            if (pthread_setaffinity_np(writer->thread, sizeof(cpu_set_t), &cpuset) != 0) {
+                DLOG_ERROR_PRINT("Error pinning %s to CPU %d\n", name, config.cpus[w % config.cpu_count]);
+            }
+        }
+        async_ctl.count = w + 1;
+    }
+    async_ctl.ok = async_ctl.count > 0;
+}
+
+// 为异步实例分配写出线程：配置了 logger.X.writer 时使用指定线程，否则轮流分配
+static struct async_writer *async_writer_assign(int preferred) {
+    pthread_once(&async_thread_once, async_thread_start);
+    if (!async_ctl.ok) return NULL;
+    uint32_t index = preferred >= 0 ? (uint32_t)preferred : async_ctl.next++;
+    return &async_ctl.writers[index % (uint32_t)async_ctl.count];
+}
+
+static pthread_once_t bg_thread_once = PTHREAD_ONCE_INIT;
+static void bg_report_drops(int force);
+static void bg_report_suppressed(int force);
+static void bg_dump_stats();
+
+// 统计定时输出，来自配置文件中的 dlog.stats_* 全局项
+static struct {
+    int interval_ms;            // 0 表示不输出
+    char logger_name[MAX_CONFIG_VALUE_SIZE];    // 统计写到该模块名的实例，按普通模块配置输出方式
+    uint64_t next_dump_ms;      // 仅后台线程访问
+} stats_ctl = {
+    .logger_name = "dlog_stats",
+};
+static pthread_once_t bg_config_once = PTHREAD_ONCE_INIT;
+
+// 配置文件监视：inotify 监视配置文件所在目录，后台线程每个周期非阻塞读取事件
+static struct {
+    int fd;
+} config_watch = {
+    .fd = -1,
+};
+
+static void config_watch_start() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        DLOG_ERROR_PRINT("Error creating inotify instance (errno: %d)\n", errno);
+        return;
+    }
+    // 编辑器常以改名方式替换文件，因此监视目录而不是文件本身
+    if (inotify_add_watch(fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        DLOG_ERROR_PRINT("Error watching config file %s (errno: %d)\n", LOGGER_CONFIG, errno);
+        close(fd);
+        return;
+    }
+    config_watch.fd = fd;
+}
+
+// 后台线程相关的全局配置：dlog.stats_interval（秒）/ dlog.stats_logger / dlog.config_watch；
+// 重新加载时只更新统计输出周期
+static void bg_config_apply(const config_table_t* table, int initial) {
+    const char* value = config_table_get(table, "dlog.stats_interval");
+    __atomic_store_n(&stats_ctl.interval_ms, value ? atoi(value) * 1000 : 0, __ATOMIC_RELAXED);
+    if (!initial) return;
+    if ((value = config_table_get(table, "dlog.stats_logger")) != NULL) {
+        snprintf(stats_ctl.logger_name, sizeof(stats_ctl.logger_name), "%s", value);
+    }
+    if ((value = config_table_get(table, "dlog.config_watch")) != NULL &&
+        (strcmp(value, "on") == 0 || strcmp(value, "true") == 0 || strcmp(value, "1") == 0)) {
+        config_watch_start();
+    }
+}
+
+static void bg_config_load() {
+    bg_config_apply(config_acquire(), 1);
+    config_release();
+}
+
+// 共享文件的缓冲数据按其中最短的落盘间隔写出
+static void bg_flush_loggers(int force) {
+    uint64_t now = monotonic_ms();
+    for (logger_entry_t* entry = __atomic_load_n(&logger_ctl_inst.all, __ATOMIC_ACQUIRE); entry; entry = entry->all_next) {
+        logger_t* logger = entry->logger;
+        for (int i = 0; i < logger->output_count; i++) {
+            log_sink* sink = __atomic_load_n(&logger->outputs[i].sink, __ATOMIC_ACQUIRE);
+            if (!sink || sink->fd < 0 || !__atomic_load_n(&sink->write_len, __ATOMIC_RELAXED)) continue;
+            if (force || now - sink->pending_since_ms >= (uint64_t)logger->flush_interval_ms) {
+                log_file_flush(sink);
+            }
+        }
+    }
+}
+
+// 执行到期的按时间滚动和写入线程请求的按大小滚动；持有 sink_ctl.mutex，与打开、关闭文件串行
+static void bg_rotate_sinks() {
+    time_t now = time(NULL);
+    pthread_mutex_lock(&sink_ctl.mutex);
+    for (log_sink* sink = sink_ctl.all; sink; sink = sink->next) {
+        if (sink->fd < 0) continue;
+        if (__atomic_exchange_n(&sink->reschedule_rotate, 0, __ATOMIC_ACQUIRE)) {
+            sink->next_rotate_at = log_file_next_rotate_at(sink->rotate_time, now);
+        }
+        if (sink->rotate_time != ROTATE_NONE && now >= sink->next_rotate_at) {
+            // 空文件不滚动，只推进下一次滚动时刻
+            uint64_t empty_size = sink->type == OUTPUT_BINARY ? DLOG_BIN_MAGIC_LEN : 0;
+            if (log_file_size(sink) > empty_size) {
+                __atomic_store_n(&sink->rotate_pending, 1, __ATOMIC_RELEASE);
+            } else {
+                sink->next_rotate_at = log_file_next_rotate_at(sink->rotate_time, now);
+            }
+        }
+        if (__atomic_load_n(&sink->rotate_pending, __ATOMIC_ACQUIRE)) {
+            log_file_rotate(sink);
+        }
+        if (sink->type == OUTPUT_MMAP) {
+            mmap_sink_prepare(sink->mmap);
+        }
+    }
+    pthread_mutex_unlock(&sink_ctl.mutex);
+}
+
+// 配置文件被改写或替换后重新加载
+static void bg_check_config() {
+    if (config_watch.fd < 0) return;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t len;
+    while ((len = read(config_watch.fd, events, sizeof(events))) > 0) {
+        for (char* p = events; p < events + len; ) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            if (event->len && strcmp(event->name, LOGGER_CONFIG) == 0) {
+                changed = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (changed) {
+        dlog_reload();
+    }
+}
+
+static void *bg_thread_func(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&bg_ctl.mutex);
+    while (bg_ctl.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += DLOG_BG_TICK_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+        }
+        pthread_cond_timedwait(&bg_ctl.cond, &bg_ctl.mutex, &deadline);
+        pthread_mutex_unlock(&bg_ctl.mutex);
+        bg_check_config();
+        bg_rotate_sinks();
+        bg_report_drops(0);
+        bg_report_suppressed(0);
+        bg_dump_stats();
+        bg_flush_loggers(0);
+        pthread_mutex_lock(&bg_ctl.mutex);
+    }
+    pthread_mutex_unlock(&bg_ctl.mutex);
+    return NULL;
+}
+
+static void bg_thread_start() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&bg_ctl.cond, &attr);
+    pthread_condattr_destroy(&attr);
+    bg_ctl.running = 1;
+    if (pthread_create(&bg_ctl.thread, NULL, bg_thread_func, NULL) != 0) {
+        DLOG_ERROR_PRINT("Error creating background log thread\n");
+        bg_ctl.running = 0;
+    }
+}
+
+static void bg_thread_stop() {
+    pthread_mutex_lock(&bg_ctl.mutex);
+    int running = bg_ctl.running;
+    bg_ctl.running = 0;
+    pthread_cond_signal(&bg_ctl.cond);
+    pthread_mutex_unlock(&bg_ctl.mutex);
+    if (running) {
+        pthread_join(bg_ctl.thread, NULL);
+    }
+}
+
+// 预先编码 json / logfmt 每个等级的 "等级 + 实例名" 字段，放在一块连续内存中
+static int logger_level_heads(logger_t* logger, const char* logger_name) {
+    static const char* json_levels[DLOG_STATS_LEVELS] = { "NONE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+    static const char* logfmt_levels[DLOG_STATS_LEVELS] = { "none", "debug", "info", "warn", "error", "fatal" };
+    const char** levels = logger->format == DLOG_FORMAT_JSON ? json_levels : logfmt_levels;
+    size_t total = 0;
+    for (int l = 0; l < DLOG_STATS_LEVELS; l++) {
+        logger->level_head_len[l] = (uint32_t)dlog_kv_level(NULL, 0, logger->format, levels[l], logger_name);
+        total += logger->level_head_len[l] + 1;
+    }
+    logger->level_heads = (char*)malloc(total);
+    if (!logger->level_heads) return -1;
+    char* p = logger->level_heads;
+    for (int l = 0; l < DLOG_STATS_LEVELS; l++) {
+        dlog_kv_level(p, logger->level_head_len[l] + 1, logger->format, levels[l], logger_name);
+        logger->level_head[l] = p;
+        p += logger->level_head_len[l] + 1;
+    }
+    return 0;
+}
+
+// 输出端的排列顺序：二进制输出端在前，先写出捕获的参数，之后文本输出端再就地格式化
+static void logger_output_order(const logger_config_t* config, int* order) {
+    int n = 0;
+    for (int i = 0; i < config->output_count; i++) {
+        if (config->outputs[i].type == OUTPUT_BINARY) order[n++] = i;
+    }
+    for (int i = 0; i < config->output_count; i++) {
+        if (config->outputs[i].type != OUTPUT_BINARY) order[n++] = i;
+    }
+}
+
+// 实例日志等级：各输出端都设置了更高的等级时提高到其中最低的一个，不格式化没有输出端接收的日志
+static int logger_gate_level(const logger_config_t* config) {
+    int level = LOG_FATAL;
+    for (int i = 0; i < config->output_count; i++) {
+        int output_level = config->outputs[i].level > (int)config->level ? config->outputs[i].level : (int)config->level;
+        if (output_level < level) level = output_level;
+    }
+    return level;
+}
+
+void logger_free(logger_t* logger) {
+    if (logger) {
+        for (int i = 0; i < logger->output_count; i++) {
+            if (logger->outputs[i].sink) {
+                log_sink_release(logger->outputs[i].sink);
+            }
+            free(logger->outputs[i].filename);
         }
+        while (logger->rings) {
+            struct recorder_ring* ring = logger->rings;
+            logger->rings = ring->next;
+            free(ring);
+        }
+        free(logger->level_heads);
+        free(logger->stats);
         free(logger);
     }
 }
 
-logger_ctl_t* logger_ctl_instance() {
-    if (!logger_ctl_inst) {
-        logger_ctl_inst = (logger_ctl_t*)malloc(sizeof(logger_ctl_t));
-        if (!logger_ctl_inst) return NULL;
-        
-        logger_ctl_inst->count = 0;
-        logger_ctl_inst->capacity = INITIAL_LOGGER_CAPACITY;
-        logger_ctl_inst->loggers = (logger_t**)malloc(sizeof(logger_t*) * logger_ctl_inst->capacity);
-        logger_ctl_inst->module_names = (char**)malloc(sizeof(char*) * logger_ctl_inst->capacity);
+logger_t* logger_create(const char* logger_name, const logger_config_t* config) {
+    logger_t* log = (logger_t*)malloc(sizeof(logger_t));
+    if (!log) return NULL;
+    
+    log->gate.level = logger_gate_level(config);
+    log->record_level = 0;
+    log->recorder_id = 0;
+    log->recorder_entries = 0;
+    log->rings = NULL;
+    log->recorder_mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+    if (config->recorder_entries > 0) {
+        // 等级不低于 DEBUG 的日志都进入 log_emit，其中低于配置等级的只记录
+        if (recorder_next_id < DLOG_RECORDER_MAX_LOGGERS) {
+            log->recorder_id = (int)recorder_next_id++;
+            log->recorder_entries = (uint32_t)config->recorder_entries;
+            log->record_level = log->gate.level;
+            log->gate.level = LOG_DEBUG;
+        } else {
+            DLOG_ERROR_PRINT("Too many flight recorders, %s records nothing\n", logger_name);
+        }
+    }
+    log->output_count = 0;
+    log->binary_outputs = 0;
+    log->journal = 0;
+    for (int i = 0; i < config->output_count; i++) {
+        if (config->outputs[i].type == OUTPUT_BINARY) log->binary_outputs++;
+    }
+    log->precision = config->precision;
+    log->time_style = config->time_style;
+    log->deferred = config->deferred;
+    // 二进制输出有自己的记录格式，键值对按文本编码后作为文本条目记录
+    log->format = log->binary_outputs == config->output_count ? DLOG_FORMAT_TEXT : config->format;
+    log->level_heads = NULL;
+    log->writer = NULL;
+    log->overflow = config->overflow;
+    log->dropped = 0;
+    log->dropped_reported = 0;
+    log->dropped_seen = 0;
+    log->sync_fallbacks = 0;
+    log->stats = NULL;
+    log->flush_always = config->flush_always;
+    log->flush_level = config->flush_level;
+    log->flush_interval_ms = config->flush_interval_ms;
+    log->flush_bytes = config->flush_bytes;
+    if ((log->format != DLOG_FORMAT_TEXT && logger_level_heads(log, logger_name) != 0) ||
+        posix_memalign((void**)&log->stats, CACHE_LINE_SIZE, sizeof(struct logger_stats_shard) * STATS_SHARDS) != 0) {
+        log->stats = NULL;
+        logger_free(log);
+        return NULL;
+    }
+    memset(log->stats, 0, sizeof(struct logger_stats_shard) * STATS_SHARDS);
+
+    int order[MAX_LOGGER_OUTPUTS];
+    logger_output_order(config, order);
+    for (int i = 0; i < config->output_count; i++) {
+        const output_config_t* output_config = &config->outputs[order[i]];
+        struct logger_output* output = &log->outputs[i];
+        output->type = output_config->type;
+        output->level = output_config->level;
+        output->sink = NULL;
+        output->journal_file = -1;
+        output->filename = strdup(output_config->filename);
+        log->output_count = i + 1;
+        if (!output->filename) {
+            logger_free(log);
+            return NULL;
+        }
+        if (output_to_file(output->type)) {
+            // 同一路径的输出端共享输出文件
+            output->sink = log_sink_acquire(output->filename, output->type, logger_name, config);
+            if (!output->sink) {
+                logger_free(log);
+                return NULL;
+            }
+            // 未落盘的数据由后台线程定时写出
+            pthread_once(&bg_thread_once, bg_thread_start);
+        }
+    }
+    if (config->async) {
+        log->writer = async_writer_assign(config->writer);
+        if (!log->writer) {
+            DLOG_ERROR_PRINT("Async log writers unavailable, %s falls back to sync mode\n", logger_name);
+        }
+    }
+    // 异步实例的文件输出端登记到崩溃日志环（二进制输出的记录无法按行补写）
+    if (log->writer && !log->binary_outputs && dlog_journal_active()) {
+        for (int i = 0; i < log->output_count; i++) {
+            struct logger_output* output = &log->outputs[i];
+            if (output->type != OUTPUT_FILE) continue;
+            output->journal_file = dlog_journal_file(output->sink->path);
+            if (output->journal_file >= 0) log->journal = 1;
+        }
+    }
+    return log;
+}
+
+static logger_t* logger_ctl_lookup(logger_ctl_t* ctl, const char* module_name, uint32_t hash) {
+    logger_entry_t* entry = __atomic_load_n(&ctl->buckets[hash & (LOGGER_HASH_BUCKETS - 1)], __ATOMIC_ACQUIRE);
+    for (; entry; entry = entry->next) {
+        if (entry->hash == hash && strcmp(entry->module_name, module_name) == 0) {
+            return entry->logger;
+        }
     }
-    return logger_ctl_inst;
+    return NULL;
 }
 
 void logger_ctl_free() {
-    if (logger_ctl_inst) {
-        for (int i = 0; i < logger_ctl_inst->count; i++) {
-            logger_free(logger_ctl_inst->loggers[i]);
-            free(logger_ctl_inst->module_names[i]);
-        }
-        free(logger_ctl_inst->loggers);
-        free(logger_ctl_inst->module_names);
-        free(logger_ctl_inst);
-        logger_ctl_inst = NULL;
+    logger_ctl_t* ctl = &logger_ctl_inst;
+    pthread_mutex_lock(&ctl->register_mutex);
+    logger_entry_t* entry = ctl->all;
+    while (entry) {
+        logger_entry_t* next = entry->all_next;
+        logger_free(entry->logger);
+        free(entry->module_name);
+        free(entry);
+        entry = next;
     }
+    memset(ctl->buckets, 0, sizeof(ctl->buckets));
+    ctl->all = NULL;
+    ctl->count = 0;
+    pthread_mutex_unlock(&ctl->register_mutex);
 }
 
 void* logger_ctl_register_logger(const char* module_name) {
-    logger_ctl_t* ctl = logger_ctl_instance();
-    if (!ctl || !module_name) return NULL;
-    
-    // Check if already registered
-    for (int i = 0; i < ctl->count; i++) {
-        if (strcmp(ctl->module_names[i], module_name) == 0) {
-            return ctl->loggers[i];
-        }
+    logger_ctl_t* ctl = &logger_ctl_inst;
+    if (!module_name) return NULL;
+
+    // 已注册则直接返回（无锁）
+    uint32_t hash = fnv1a_hash(module_name);
+    logger_t* loger = logger_ctl_lookup(ctl, module_name, hash);
+    if (loger) return loger;
+
+    pthread_mutex_lock(&ctl->register_mutex);
+    // 加锁后再查一次，防止并发重复注册
+    loger = logger_ctl_lookup(ctl, module_name, hash);
+    if (loger) {
+        pthread_mutex_unlock(&ctl->register_mutex);
+        return loger;
     }
-    
+
     // Get logger config
-    log_type type = OUTPUT_SCREEN;
-    log_level level = LOG_INFO;
-    char filename[MAX_CONFIG_VALUE_SIZE] = DEFAULT_LOG_SUFFIX;
-    logger_ctl_get_config(module_name, &type, &level, filename);
-    
+    logger_config_t config;
+    logger_config_default(&config);
+    logger_config_parse(config_acquire(), module_name, &config);
+    config_release();
+    // 配置了统计定时输出或配置文件监视时由后台线程负责
+    pthread_once(&bg_config_once, bg_config_load);
+    if (__atomic_load_n(&stats_ctl.interval_ms, __ATOMIC_RELAXED) > 0 || config_watch.fd >= 0) {
+        pthread_once(&bg_thread_once, bg_thread_start);
+    }
+
     // Create and register logger
-    logger_t* loger = logger_create(module_name, level, type, filename);
-    if (!loger) return NULL;
-    
-    // Resize arrays if needed
-    if (ctl->count >= ctl->capacity) {
-        ctl->capacity *= CAPACITY_GROWTH_FACTOR;
-        ctl->loggers = (logger_t**)realloc(ctl->loggers, sizeof(logger_t*) * ctl->capacity);
-        ctl->module_names = (char**)realloc(ctl->module_names, sizeof(char*) * ctl->capacity);
+    loger = logger_create(module_name, &config);
+    logger_entry_t* entry = loger ? (logger_entry_t*)malloc(sizeof(logger_entry_t)) : NULL;
+    if (!entry) {
+        logger_free(loger);
+        pthread_mutex_unlock(&ctl->register_mutex);
+        return NULL;
     }
-    
-    ctl->module_names[ctl->count] = strdup(module_name);
-    ctl->loggers[ctl->count] = loger;
+    entry->module_name = strdup(module_name);
+    entry->hash = hash;
+    entry->logger = loger;
+    entry->next = ctl->buckets[hash & (LOGGER_HASH_BUCKETS - 1)];
+    entry->all_next = ctl->all;
+    __atomic_store_n(&ctl->all, entry, __ATOMIC_RELEASE);
     ctl->count++;
-    
+    // 条目完全初始化后再发布
+    __atomic_store_n(&ctl->buckets[hash & (LOGGER_HASH_BUCKETS - 1)], entry, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ctl->register_mutex);
+
     return loger;
 }
 
@@ -424,30 +2979,551 @@ void* log_module_init(const char* module_name) {
         printf("module name is NULL");
         return NULL;
     }
-#if (ASYNC_LOG)
-    static pthread_mutex_t async_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_lock(&async_thread_mutex);
-    if (!async_thread_started) {
-        async_thread_started = 1;
-        // 初始化队列
-        log_head = (struct log_queue*)malloc(sizeof(struct log_queue));
-        log_tail = (struct log_queue*)malloc(sizeof(struct log_queue));
-        log_head->prev = log_tail;
-        log_tail->next = log_head;
-        log_tail->log = NULL;
-
-        // 启动异步线程
-        if (pthread_create(&thread_id, NULL, async_log_thread_func, NULL) != 0) {
-            DLOG_ERROR_PRINT("Error creating async log thread\n");
-            async_thread_started = 0;
-            pthread_mutex_unlock(&async_thread_mutex);
-            return NULL;
+    return logger_ctl_register_logger(module_name);
+}
+
+// 日志内容：格式串和可变参数（log_msg），类型化参数（log_typed_msg），或消息和键值对（log_kv）
+struct log_source {
+    const char *format;
+    va_list *args;
+    const struct dlog_value *values;    // log_kv 时为交替排列的键值对
+    int count;
+    const char *msg;                    // log_kv 的消息
+    int encoding;                       // 实例的行格式
+};
+
+static int log_source_render_raw(char *out, size_t cap, const struct log_source *source) {
+    if (source->values) {
+        return dlog_typed_render(out, cap, source->values, source->count);
+    }
+    va_list args;
+    va_copy(args, *source->args);
+    int written = vsnprintf(out, cap, source->format, args);
+    va_end(args);
+    return written;
+}
+
+// 按来源格式化到 out，语义同 snprintf；可重复调用（每次复制参数列表）。
+// json / logfmt 实例的普通消息先格式化到栈上（放不下时借用消息块）再转义编码
+static int log_source_render(char *out, size_t cap, const struct log_source *source) {
+    if (source->msg) {
+        return dlog_kv_render(out, cap, source->encoding, source->msg, strlen(source->msg),
+                              source->values, source->count);
+    }
+    if (source->encoding == DLOG_FORMAT_TEXT) {
+        return log_source_render_raw(out, cap, source);
+    }
+    char local[RENDER_STACK_SIZE];
+    const char *raw = local;
+    int len = log_source_render_raw(local, sizeof(local), source);
+    if (len < 0) return len;
+    char *block = NULL;
+    int class_index = -1;
+    if ((size_t)len >= sizeof(local)) {
+        block = arena_alloc((size_t)len + 1 < MAX_BUFFER ? (size_t)len + 1 : MAX_BUFFER, &class_index);
+        if (block) {
+            len = log_source_render_raw(block, arena_classes[class_index].block_size, source);
+            if (len >= (int)arena_classes[class_index].block_size) len = (int)arena_classes[class_index].block_size - 1;
+            raw = block;
+        } else {
+            len = (int)sizeof(local) - 1;
+        }
+    }
+    int written = len < 0 ? len : dlog_kv_render(out, cap, source->encoding, raw, (size_t)len, NULL, 0);
+    if (block) arena_free(class_index, block);
+    return written;
+}
+
+// drop_oldest：取走本实例在队列中最早的一条日志并归还其缓冲区和消息块，返回是否取到
+static int log_drop_oldest(logger_t *logger) {
+    struct log_buffer *oldest = logger->writer ? log_queue_steal(logger->writer, logger) : NULL;
+    if (!oldest) return 0;
+    __atomic_add_fetch(&logger->dropped, 1, __ATOMIC_RELAXED);
+    release_buffer(oldest);
+    return 1;
+}
+
+// 将日志消息添加到所属写出线程的队列；队列满时 drop_new / drop_oldest 直接丢弃（取走的槽位要等写出线程经过才能复用），
+// 其余策略唤醒消费者并让出CPU重试
+static int log_enqueue(logger_t *logger, struct log_buffer *log_buffer, int overflow) {
+    while (log_queue_push(logger->writer, log_buffer) != 0) {
+        if (overflow == OVERFLOW_DROP_NEW || overflow == OVERFLOW_DROP_OLDEST) {
+            __atomic_add_fetch(&logger->dropped, 1, __ATOMIC_RELAXED);
+            release_buffer(log_buffer);
+            return -1;
+        }
+        log_queue_wakeup(logger->writer);
+        sched_yield();
+    }
+    return 0;
+}
+
+// 线程退出时放弃自己的记录环，其中的记录保留到被新线程认领前，仍可由 dlog_dump_recorder 写出
+static void recorder_destructor(void *arg) {
+    struct recorder_ring **rings = (struct recorder_ring **)arg;
+    for (int i = 0; i < DLOG_RECORDER_MAX_LOGGERS; i++) {
+        if (rings[i]) {
+            __atomic_store_n(&rings[i]->owner, 0, __ATOMIC_RELEASE);
+            rings[i] = NULL;
+        }
+    }
+}
+
+static void recorder_key_init() {
+    pthread_key_create(&recorder_key, recorder_destructor);
+}
+
+// 当前线程在该实例上的记录环，首次使用时认领空闲的环或新建一个
+static struct recorder_ring *recorder_ring_get(logger_t *logger) {
+    struct recorder_ring *ring = recorder_tls[logger->recorder_id];
+    if (__builtin_expect(ring != NULL, 1)) return ring;
+    pthread_once(&recorder_key_once, recorder_key_init);
+    pid_t tid = current_thread_id();
+    pthread_mutex_lock(&logger->recorder_mutex);
+    for (ring = logger->rings; ring; ring = ring->next) {
+        if (__atomic_load_n(&ring->owner, __ATOMIC_ACQUIRE) == 0) break;
+    }
+    if (!ring) {
+        ring = (struct recorder_ring *)calloc(1, sizeof(struct recorder_ring) +
+                                                 logger->recorder_entries * sizeof(struct recorder_entry));
+        if (ring) {
+            ring->capacity = logger->recorder_entries;
+            ring->next = logger->rings;
+            logger->rings = ring;
+        }
+    }
+    if (ring) {
+        ring->owner = tid;
+        __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+        ring->dumped = 0;
+    }
+    pthread_mutex_unlock(&logger->recorder_mutex);
+    if (ring) {
+        recorder_tls[logger->recorder_id] = ring;
+        pthread_setspecific(recorder_key, recorder_tls);
+    } else {
+        DLOG_ERROR_PRINT("Failed to allocate flight recorder ring\n");
+    }
+    return ring;
+}
+
+// 记入调用线程的记录环：只取时间戳并捕获参数，格式化留到写出时；参数放不下或非文本来源时格式化后截断保存
+static void recorder_capture(logger_t *logger, log_level level, const struct dlog_site *site,
+                             const struct log_source *source) {
+    struct recorder_ring *ring = recorder_ring_get(logger);
+    if (!ring) return;
+    uint64_t n = ring->head;
+    struct recorder_entry *entry = &ring->entries[n % ring->capacity];
+    __atomic_store_n(&entry->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    clock_gettime(DLOG_TIME_CLOCK, &entry->ts);
+    entry->level = (uint8_t)level;
+    entry->site = logger->binary_outputs == logger->output_count ? NULL : site;
+    entry->tid = entry->site ? current_thread_id() : 0;
+    entry->format = NULL;
+    if (source->format && source->encoding == DLOG_FORMAT_TEXT) {
+        va_list capture_args;
+        va_copy(capture_args, *source->args);
+        int captured = dlog_fmt_capture(entry->data, sizeof(entry->data), source->format, capture_args);
+        va_end(capture_args);
+        if (captured >= 0) {
+            entry->format = source->format;
+            entry->len = (uint32_t)captured;
+        }
+    }
+    if (!entry->format) {
+        int written = log_source_render(entry->data, sizeof(entry->data), source);
+        if (written < 0) {
+            written = snprintf(entry->data, sizeof(entry->data), "%s", LOG_FORMAT_ERROR_MSG);
         }
-        pthread_detach(thread_id);  // 分离线程
+        entry->len = (uint32_t)written < sizeof(entry->data) ? (uint32_t)written : sizeof(entry->data) - 1;
     }
-    pthread_mutex_unlock(&async_thread_mutex);
+    __atomic_store_n(&entry->seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, n + 1, __ATOMIC_RELEASE);
+}
+
+// 把记录环中尚未写出的条目按序交给输出端，调用方持有 recorder_mutex；返回写出的条数
+static int recorder_dump_ring(logger_t *logger, struct recorder_ring *ring) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t n = ring->dumped;
+    if (head - n > ring->capacity) n = head - ring->capacity;
+    int dumped = 0;
+    // 按实例的溢出策略取缓冲区：只有 block 等待，其余策略取不到时停止写出，剩下的记录计为丢弃
+    int wait = logger->overflow == OVERFLOW_BLOCK;
+    for (; n < head; n++) {
+        struct recorder_entry *entry = &ring->entries[n % ring->capacity];
+        uint64_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        if (seq != 2 * n + 2) continue;
+        struct log_buffer *log = wait ? get_buffer_wait() : get_buffer();
+        if (!log) break;
+        if (log->capacity <= entry->len &&
+            (wait ? log_buffer_grow_wait(log, entry->len + 1) : log_buffer_grow(log, entry->len + 1)) != 0) {
+            release_buffer(log);
+            break;
+        }
+        memcpy(log->message, entry->data, entry->len);
+        log->message[entry->len] = '\0';
+        log->ts = entry->ts;
+        log->format = entry->format;
+        log->site = entry->site;
+        log->tid = entry->tid;
+        log->level = (log_level)entry->level;
+        // 复制期间被所属线程覆盖的条目丢弃
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq) {
+            release_buffer(log);
+            continue;
+        }
+        log->logger = logger;
+        log->deferred = log->format != NULL;
+        log->args_len = entry->len;
+        log->time_len = 0;
+        log->site_len = 0;
+#if DLOG_STATS_TIMING
+        log->enqueue_ns = stats_now_ns();
 #endif
-    return logger_ctl_register_logger(module_name);
+        if (logger->writer) {
+            // 队列满时 drop_new / drop_oldest 已丢弃这一条并计数
+            if (log_enqueue(logger, log, logger->overflow) != 0) {
+                n++;
+                break;
+            }
+        } else {
+            logger_log_message(log);
+            release_buffer(log);
+        }
+        dumped++;
+    }
+    if (n < head) {
+        __atomic_add_fetch(&logger->dropped, head - n, __ATOMIC_RELAXED);
+    }
+    ring->dumped = head;
+    return dumped;
+}
+
+// 写出调用线程在该实例上的记录，在 ERROR/FATAL 日志之前调用
+static void recorder_dump_thread(logger_t *logger) {
+    struct recorder_ring *ring = recorder_tls[logger->recorder_id];
+    if (!ring) return;
+    pthread_mutex_lock(&logger->recorder_mutex);
+    recorder_dump_ring(logger, ring);
+    pthread_mutex_unlock(&logger->recorder_mutex);
+}
+
+static int recorder_dump_logger(logger_t *logger) {
+    int dumped = 0;
+    pthread_mutex_lock(&logger->recorder_mutex);
+    for (struct recorder_ring *ring = logger->rings; ring; ring = ring->next) {
+        dumped += recorder_dump_ring(logger, ring);
+    }
+    pthread_mutex_unlock(&logger->recorder_mutex);
+    return dumped;
+}
+
+int dlog_dump_recorder(void *logger) {
+    if (logger) {
+        return ((logger_t*)logger)->recorder_entries ? recorder_dump_logger((logger_t*)logger) : 0;
+    }
+    int dumped = 0;
+    logger_entry_t *entry = __atomic_load_n(&logger_ctl_inst.all, __ATOMIC_ACQUIRE);
+    for (; entry; entry = entry->all_next) {
+        if (entry->logger->recorder_entries) dumped += recorder_dump_logger(entry->logger);
+    }
+    return dumped;
+}
+
+// 把入队的日志记入崩溃日志环，写往该等级日志的各文件输出端；环已满时不记录，日志照常写出。
+// 记录的是与写出线程相同的整行（时间、等级、调用点前缀），时间和前缀缓存在缓冲区中，写出线程不再重复渲染
+static uint64_t log_journal_append(logger_t *logger, struct log_buffer *log) {
+    uint64_t files = 0;
+    for (uint32_t mask = logger_output_mask(logger, log->level); mask; mask &= mask - 1) {
+        int file = __atomic_load_n(&logger->outputs[__builtin_ctz(mask)].journal_file, __ATOMIC_RELAXED);
+        if (file >= 0) files |= 1ull << file;
+    }
+    if (!files) return 0;
+    struct iovec iov[LOG_IOV_PER_MSG];
+    int iovcnt = log_buffer_iov(logger, log, iov);
+    return dlog_journal_append(files, iov, iovcnt);
+}
+
+// 生成并写出（或入队）一条日志，被丢弃时返回 -1
+static int log_emit(logger_t *logger, log_level level, int overflow, const struct dlog_site *site,
+                    const struct log_source *source) {
+    int record_level = __atomic_load_n(&logger->record_level, __ATOMIC_RELAXED);
+    if (record_level) {
+        if ((int)level < record_level) {
+            recorder_capture(logger, level, site, source);
+            return 0;
+        }
+        // 出错时先写出本线程此前记录的日志，排在出错日志之前
+        if (level >= LOG_ERROR) {
+            recorder_dump_thread(logger);
+        }
+    }
+    struct log_buffer *log_buffer = get_buffer();
+    // 缓冲区耗尽时按实例的溢出策略处理，不做固定时长的休眠重试
+    char fallback_time[TIME_STRING_BUFFER_SIZE];
+    char fallback_site[SITE_PREFIX_SIZE];
+    char fallback_message[RENDER_STACK_SIZE];
+    struct log_buffer fallback = {
+        .time_str = fallback_time,
+        .site_str = fallback_site,
+        .message = fallback_message,
+        .inline_message = fallback_message,
+        .capacity = sizeof(fallback_message),
+        .block_class = -1,
+    };
+    if (!log_buffer) {
+        switch (overflow) {
+            case OVERFLOW_DROP_OLDEST:
+                // 归还的缓冲区进入本线程缓存，随即取回；本实例没有排队的日志时退化为 drop_new
+                if (log_drop_oldest(logger) && (log_buffer = get_buffer()) != NULL) break;
+                // fall through
+            case OVERFLOW_DROP_NEW:
+                __atomic_add_fetch(&logger->dropped, 1, __ATOMIC_RELAXED);
+                return -1;
+            case OVERFLOW_SYNC_FALLBACK:
+                log_buffer = &fallback;
+                __atomic_add_fetch(&logger->sync_fallbacks, 1, __ATOMIC_RELAXED);
+                break;
+            default:
+                log_buffer = get_buffer_wait();
+                break;
+        }
+        if (!log_buffer) {
+            DLOG_ERROR_PRINT("Error: Unable to get log buffer\n");
+            __atomic_add_fetch(&logger->dropped, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+    int direct = (log_buffer == &fallback || !logger->writer);
+#if DLOG_STATS_TIMING
+    uint64_t format_start = stats_now_ns();
+#endif
+
+    // 有二进制输出端时和异步延迟格式化只捕获参数，格式化留给写出线程或解码工具；参数放不下时改为立即格式化。
+    // 类型化参数本身已无需解析格式串，json / logfmt 需要转义，这两种情况总是立即格式化
+    log_buffer->deferred = 0;
+    if (source->format && source->encoding == DLOG_FORMAT_TEXT &&
+        (logger->binary_outputs || (!direct && logger->deferred && !logger->journal))) {
+        va_list capture_args;
+        va_copy(capture_args, *source->args);
+        int captured = dlog_fmt_capture(log_buffer->message, log_buffer->capacity, source->format, capture_args);
+        va_end(capture_args);
+        // 自带空间放不下参数时借用一块再捕获一次
+        if (captured < 0 && log_buffer->capacity < RENDER_STACK_SIZE &&
+            log_buffer_grow(log_buffer, RENDER_STACK_SIZE) == 0) {
+            va_copy(capture_args, *source->args);
+            captured = dlog_fmt_capture(log_buffer->message, log_buffer->capacity, source->format, capture_args);
+            va_end(capture_args);
+        }
+        if (captured >= 0) {
+            log_buffer->format = source->format;
+            log_buffer->args_len = (uint32_t)captured;
+            log_buffer->deferred = 1;
+        }
+    }
+    if (!log_buffer->deferred) {
+        // 先格式化到当前空间，放不下时按实际长度借用更大的块再格式化一次
+        char *first_message = log_buffer->message;
+        int64_t written = log_source_render(log_buffer->message, log_buffer->capacity, source);
+        if (written >= log_buffer->capacity && log_buffer_grow(log_buffer, (size_t)written + 1) != 0 &&
+            log_buffer != &fallback) {
+            // 消息块用尽时与缓冲区耗尽一样按溢出策略处理
+            switch (overflow) {
+                case OVERFLOW_DROP_OLDEST:
+                    if (log_drop_oldest(logger) && log_buffer_grow(log_buffer, (size_t)written + 1) == 0) break;
+                    // fall through
+                case OVERFLOW_DROP_NEW:
+                    __atomic_add_fetch(&logger->dropped, 1, __ATOMIC_RELAXED);
+                    release_buffer(log_buffer);
+                    return -1;
+                case OVERFLOW_SYNC_FALLBACK:
+                    release_buffer(log_buffer);
+                    log_buffer = &fallback;
+                    direct = 1;
+                    __atomic_add_fetch(&logger->sync_fallbacks, 1, __ATOMIC_RELAXED);
+                    break;
+                default:
+                    log_buffer_grow_wait(log_buffer, (size_t)written + 1);
+                    break;
+            }
+        }
+        if (log_buffer->message != first_message) {
+            written = log_source_render(log_buffer->message, log_buffer->capacity, source);
+        }
+        if (written < 0) {
+            DLOG_ERROR_PRINT("Error: vsnprintf failed\n");
+            snprintf(log_buffer->message, log_buffer->capacity, "%s", LOG_FORMAT_ERROR_MSG);
+        } else if (written >= log_buffer->capacity) {
+            __atomic_add_fetch(&logger_stats(logger)->truncated, 1, __ATOMIC_RELAXED);
+            DLOG_ERROR_PRINT(TRUNCATION_WARNING_MSG, written);
+        }
+    }
+    // 准备日志消息
+    log_buffer->logger = logger;
+    log_buffer->level = level;
+    // 只有二进制输出端时不记录调用点前缀
+    log_buffer->site = logger->binary_outputs == logger->output_count ? NULL : site;
+    log_buffer->tid = log_buffer->site ? current_thread_id() : 0;
+    log_buffer->time_len = 0;
+    log_buffer->site_len = 0;
+    clock_gettime(DLOG_TIME_CLOCK, &log_buffer->ts);
+    if (!direct && logger->journal) {
+        log_buffer->journal = log_journal_append(logger, log_buffer);
+    }
+#if DLOG_STATS_TIMING
+    log_buffer->enqueue_ns = stats_now_ns();
+    stats_histogram_add(logger_stats(logger)->format_ns, log_buffer->enqueue_ns - format_start);
+#endif
+
+    if (!direct) {
+        return log_enqueue(logger, log_buffer, overflow);
+    } else {
+        // 发送日志消息
+        logger_log_message(log_buffer);
+        // 立即释放缓冲区
+        if (log_buffer != &fallback) {
+            release_buffer(log_buffer);
+        } else {
+            log_buffer_set_block(log_buffer, NULL, -1);
+        }
+    }
+    return 0;
+}
+
+static int log_vmsg(logger_t *logger, log_level level, int overflow, const struct dlog_site *site,
+                    const char *format, va_list args) {
+    va_list source_args;
+    va_copy(source_args, args);
+    struct log_source source = { .format = format, .args = &source_args, .encoding = logger->format };
+    int ret = log_emit(logger, level, overflow, site, &source);
+    va_end(source_args);
+    return ret;
+}
+
+static int log_internal(logger_t *logger, log_level level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int ret = log_vmsg(logger, level, OVERFLOW_DROP_NEW, NULL, format, args);
+    va_end(args);
+    return ret;
+}
+
+// 积压消除后（上一个后台周期内没有新的丢弃）写一行丢弃汇总；force 用于退出前补写
+static void bg_report_drops(int force) {
+    if (!force && __atomic_load_n(&pool_wait.waiters, __ATOMIC_RELAXED)) return;
+    for (logger_entry_t* entry = __atomic_load_n(&logger_ctl_inst.all, __ATOMIC_ACQUIRE); entry; entry = entry->all_next) {
+        logger_t* logger = entry->logger;
+        uint64_t dropped = __atomic_load_n(&logger->dropped, __ATOMIC_RELAXED);
+        if (dropped != logger->dropped_reported && (force || dropped == logger->dropped_seen) &&
+            log_internal(logger, LOG_WARN, "%llu messages dropped (overflow)",
+                         (unsigned long long)(dropped - logger->dropped_reported)) == 0) {
+            logger->dropped_reported = dropped;
+        }
+        logger->dropped_seen = dropped;
+    }
+}
+
+// 调用点限流：首次跳过时登记的调用点，后台线程定期汇报跳过条数
+static struct {
+    struct dlog_limit* head;
+    uint64_t reported_ms;   // 仅后台线程访问
+} limit_ctl;
+
+int dlog_limit_rate(struct dlog_limit *limit, uint32_t per_sec) {
+    if (per_sec == 0) return 0;
+    // GCRA：state 为下一个令牌的理论到达时刻，领先当前时刻不超过 1 秒（per_sec 个令牌）时放行
+    uint64_t interval = 1000000000ULL / per_sec;
+    uint64_t burst = interval * per_sec;
+    uint64_t now = stats_now_ns();
+    uint64_t tat = __atomic_load_n(&limit->state, __ATOMIC_RELAXED);
+    uint64_t next;
+    do {
+        uint64_t base = tat > now ? tat : now;
+        if (base - now + interval > burst) return 0;
+        next = base + interval;
+    } while (!__atomic_compare_exchange_n(&limit->state, &tat, next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return 1;
+}
+
+void dlog_limit_register(struct dlog_limit *limit, void *logger, const struct dlog_site *site) {
+    int registered = 0;
+    if (!logger || !__atomic_compare_exchange_n(&limit->registered, &registered, 1, 0,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    limit->logger = logger;
+    limit->site = site;
+    struct dlog_limit* head = __atomic_load_n(&limit_ctl.head, __ATOMIC_RELAXED);
+    do {
+        limit->next = head;
+    } while (!__atomic_compare_exchange_n(&limit_ctl.head, &head, limit, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    pthread_once(&bg_thread_once, bg_thread_start);
+}
+
+static int log_site_internal(logger_t *logger, const struct dlog_site *site, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int ret = log_vmsg(logger, site->level, OVERFLOW_DROP_NEW, site, format, args);
+    va_end(args);
+    return ret;
+}
+
+// 每 DLOG_LIMIT_REPORT_MS 为每个有跳过的调用点写一行汇总，带该调用点的前缀和等级；写出失败时留到下次
+static void bg_report_suppressed(int force) {
+    uint64_t now = monotonic_ms();
+    if (!force && now - limit_ctl.reported_ms < DLOG_LIMIT_REPORT_MS) return;
+    limit_ctl.reported_ms = now;
+    for (struct dlog_limit* limit = __atomic_load_n(&limit_ctl.head, __ATOMIC_ACQUIRE); limit; limit = limit->next) {
+        uint64_t suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+        if (suppressed && log_site_internal((logger_t*)limit->logger, limit->site, "suppressed %llu similar messages",
+                                            (unsigned long long)suppressed) != 0) {
+            __atomic_add_fetch(&limit->suppressed, suppressed, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// 每隔 dlog.stats_interval 秒把其余实例的统计各写一行到统计实例
+static void bg_dump_stats() {
+    int interval_ms = __atomic_load_n(&stats_ctl.interval_ms, __ATOMIC_RELAXED);
+    if (interval_ms <= 0) {
+        stats_ctl.next_dump_ms = 0;
+        return;
+    }
+    uint64_t now = monotonic_ms();
+    if (stats_ctl.next_dump_ms == 0) {
+        stats_ctl.next_dump_ms = now + (uint64_t)interval_ms;
+        return;
+    }
+    if (now < stats_ctl.next_dump_ms) return;
+    stats_ctl.next_dump_ms = now + (uint64_t)interval_ms;
+
+    logger_t* out = (logger_t*)log_module_init(stats_ctl.logger_name);
+    if (!out || !is_greater_than_level(out, LOG_INFO)) return;
+    for (logger_entry_t* entry = __atomic_load_n(&logger_ctl_inst.all, __ATOMIC_ACQUIRE); entry; entry = entry->all_next) {
+        if (entry->logger == out) continue;
+        struct dlog_stats stats;
+        dlog_get_stats(entry->logger, &stats);
+        unsigned long long messages = 0, bytes = 0;
+        for (int l = 0; l < DLOG_STATS_LEVELS; l++) {
+            messages += stats.messages[l];
+            bytes += stats.bytes[l];
+        }
+        log_internal(out, LOG_INFO,
+                     "%s messages=%llu bytes=%llu dropped=%llu truncated=%llu sync_fallbacks=%llu rotations=%llu "
+                     "queue=%u/%u pool=%u/%u format_p50=%lluns format_p99=%lluns "
+                     "latency_p50=%lluns latency_p99=%lluns latency_max=%lluns",
+                     entry->module_name, messages, bytes,
+                     (unsigned long long)stats.dropped, (unsigned long long)stats.truncated,
+                     (unsigned long long)stats.sync_fallbacks, (unsigned long long)stats.rotations,
+                     stats.queue_depth, stats.queue_high_water, stats.pool_in_use, stats.pool_high_water,
+                     (unsigned long long)dlog_stats_percentile(stats.format_ns, 50),
+                     (unsigned long long)dlog_stats_percentile(stats.format_ns, 99),
+                     (unsigned long long)dlog_stats_percentile(stats.latency_ns, 50),
+                     (unsigned long long)dlog_stats_percentile(stats.latency_ns, 99),
+                     (unsigned long long)dlog_stats_percentile(stats.latency_ns, 100));
+    }
 }
 
 void log_msg(void *logger, log_level level, const char *format, ...) {
@@ -455,91 +3531,292 @@ void log_msg(void *logger, log_level level, const char *format, ...) {
         DLOG_ERROR_PRINT("Error: logger=%p, format=%p\n", logger, format);
         return;
     }
+    // 等级过滤放在获取缓冲区、格式化和取时间之前
+    if (!is_greater_than_level((logger_t*)logger, level)) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    log_vmsg((logger_t*)logger, level, ((logger_t*)logger)->overflow, NULL, format, args);
+    va_end(args);
+}
+
+void log_typed_msg(void *logger, log_level level, const struct dlog_value *values, int count) {
+    if (!logger || (!values && count > 0)) {
+        DLOG_ERROR_PRINT("Error: logger=%p, values=%p\n", logger, (const void*)values);
+        return;
+    }
+    if (!is_greater_than_level((logger_t*)logger, level)) {
+        return;
+    }
+    struct log_source source = { .values = values, .count = count, .encoding = ((logger_t*)logger)->format };
+    log_emit((logger_t*)logger, level, ((logger_t*)logger)->overflow, NULL, &source);
+}
 
-    // 日志消息格式化
-    int try_count = 3;
-    struct log_buffer *log_buffer = NULL;
-    do{
-        if(try_count < 3){
-            DLOG_ERROR_PRINT("Retrying to get log buffer, attempts left: %d\n", try_count);
-            usleep(100 * 1000); // 100ms
-        }
-        log_buffer = get_buffer();
-    }while (log_buffer == NULL && try_count-- > 0);
-    if (log_buffer == NULL) {
-        DLOG_ERROR_PRINT("Error: Unable to get log buffer after multiple attempts\n");
+void log_kv_values(void *logger, log_level level, const char *msg, const struct dlog_value *kvs, int count) {
+    if (!logger || !msg || (!kvs && count > 0)) {
+        DLOG_ERROR_PRINT("Error: logger=%p, msg=%p, kvs=%p\n", logger, (const void*)msg, (const void*)kvs);
+        return;
+    }
+    if (!is_greater_than_level((logger_t*)logger, level)) {
         return;
     }
+    struct log_source source = { .values = kvs, .count = count, .msg = msg, .encoding = ((logger_t*)logger)->format };
+    log_emit((logger_t*)logger, level, ((logger_t*)logger)->overflow, NULL, &source);
+}
 
+void log_kv(void *logger, log_level level, const char *msg, ...) {
+    if (!logger || !is_greater_than_level((logger_t*)logger, level)) {
+        return;
+    }
+    // 键值对收集到栈上，超过 DLOG_MAX_VALUES / 2 对的部分忽略
+    struct dlog_value kvs[DLOG_MAX_VALUES];
+    int count = 0;
     va_list args;
-    va_start(args, format);
-    int64_t written = vsnprintf(log_buffer->message, MAX_BUFFER, format, args);
-    va_end(args);  // 结束变参访问
-    if (written < 0) {
-        DLOG_ERROR_PRINT("Error: vsnprintf failed\n");
-        strncpy(log_buffer->message, LOG_FORMAT_ERROR_MSG, MAX_BUFFER);
-    } else if (written >= MAX_BUFFER) {
-        log_buffer->message[MAX_BUFFER - 1] = '\0';  // 确保NULL结尾
-        DLOG_ERROR_PRINT(TRUNCATION_WARNING_MSG, written);
+    va_start(args, msg);
+    const char *key;
+    while ((key = va_arg(args, const char*)) != NULL) {
+        struct dlog_value value = va_arg(args, struct dlog_value);
+        if (count + 2 > DLOG_MAX_VALUES) continue;
+        kvs[count++] = dlog_value_str(key);
+        kvs[count++] = value;
     }
-    // 准备日志消息
-    log_buffer->logger = (logger_t*)logger;
-    log_buffer->level = level;
-    get_time_string(log_buffer->time_str);
-
-#if (ASYNC_LOG)
-    // 将日志消息添加到队列
-    struct log_queue *new_node = (struct log_queue*)malloc(sizeof(struct log_queue));
-    new_node->log = log_buffer;
-    pthread_mutex_lock(&log_mutex);
-    // 添加到队列尾
-    new_node->next = log_tail->next;
-    new_node->prev = log_tail;
-    log_tail->next = new_node;
-    new_node->next->prev = new_node;
-    // 通知异步线程
-    pthread_cond_signal(&log_cond);  // 确保发送信号
-    pthread_mutex_unlock(&log_mutex);
-#else
-    // 发送日志消息
-    logger_log_message(log_buffer);
-    // 立即释放缓冲区
-    release_buffer(log_buffer);
-#endif
+    va_end(args);
+    log_kv_values(logger, level, msg, kvs, count);
+}
+
+void log_site_msg(void *logger, const struct dlog_site *site, ...) {
+    if (!logger || !site || !site->format) {
+        DLOG_ERROR_PRINT("Error: logger=%p, site=%p\n", logger, (const void*)site);
+        return;
+    }
+    if (!is_greater_than_level((logger_t*)logger, site->level)) {
+        return;
+    }
+    va_list args;
+    va_start(args, site);
+    log_vmsg((logger_t*)logger, site->level, ((logger_t*)logger)->overflow, site, site->format, args);
+    va_end(args);
+}
+
+void log_flush() {
+    fflush_async_log();
+}
+
+void log_set_level(void *logger, log_level level) {
+    if (!logger) return;
+    logger_t *log = (logger_t*)logger;
+    // 启用飞行记录器时修改的是写出等级，低于它的日志仍然记录
+    __atomic_store_n(log->recorder_entries ? &log->record_level : &log->gate.level, (int)level, __ATOMIC_RELAXED);
+}
+
+// 输出端的个数和类型是否与运行中的实例一致（按 logger_output_order 排列后比较）
+static int logger_outputs_match(const logger_t* logger, const logger_config_t* config, const int* order) {
+    if (config->output_count != logger->output_count) return 0;
+    for (int i = 0; i < config->output_count; i++) {
+        if (config->outputs[order[i]].type != logger->outputs[i].type) return 0;
+    }
+    return 1;
+}
+
+// 把重新加载的配置应用到运行中的实例：各项以原子写替换，日志路径不加锁；
+// 输出端的个数和类型以及同步/异步模式在创建时决定，修改后需重启
+static void logger_reconfigure(logger_t* logger, const char* logger_name, const logger_config_t* config) {
+    int order[MAX_LOGGER_OUTPUTS];
+    logger_output_order(config, order);
+    int outputs_match = logger_outputs_match(logger, config, order);
+    if (!outputs_match) {
+        DLOG_ERROR_PRINT("log_type / sinks change of %s requires a restart\n", logger_name);
+    }
+    if (config->async != (logger->writer != NULL)) {
+        DLOG_ERROR_PRINT("mode change of %s requires a restart\n", logger_name);
+    }
+    if (logger->binary_outputs != logger->output_count && config->format != logger->format) {
+        DLOG_ERROR_PRINT("format change of %s requires a restart\n", logger_name);
+    }
+    if ((uint32_t)config->recorder_entries != logger->recorder_entries) {
+        DLOG_ERROR_PRINT("flight_recorder change of %s requires a restart\n", logger_name);
+    }
+    __atomic_store_n(logger->recorder_entries ? &logger->record_level : &logger->gate.level,
+                     logger_gate_level(config), __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->overflow, config->overflow, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->precision, config->precision, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->time_style, config->time_style, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->deferred, config->deferred, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->flush_always, config->flush_always, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->flush_level, config->flush_level, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->flush_interval_ms, config->flush_interval_ms, __ATOMIC_RELAXED);
+    __atomic_store_n(&logger->flush_bytes, config->flush_bytes, __ATOMIC_RELAXED);
+    if (!outputs_match) return;
+
+    for (int i = 0; i < logger->output_count; i++) {
+        const output_config_t* output_config = &config->outputs[order[i]];
+        struct logger_output* output = &logger->outputs[i];
+        __atomic_store_n(&output->level, output_config->level, __ATOMIC_RELAXED);
+        if (!output->sink) continue;
+        // 切换输出文件：先发布新文件再释放旧文件，旧文件没有其他实例使用时落盘并关闭；
+        // 打开失败时保留旧文件，下次重新加载时重试
+        if (strcmp(output_config->filename, output->filename) != 0) {
+            char* filename = strdup(output_config->filename);
+            log_sink* new_sink = filename ? log_sink_acquire(filename, output->type, logger_name, config) : NULL;
+            if (!new_sink) {
+                free(filename);
+            } else {
+                free(output->filename);
+                output->filename = filename;
+                log_sink_release(__atomic_exchange_n(&output->sink, new_sink, __ATOMIC_SEQ_CST));
+                if (logger->journal && output->type == OUTPUT_FILE) {
+                    __atomic_store_n(&output->journal_file, dlog_journal_file(new_sink->path), __ATOMIC_RELAXED);
+                }
+                continue;
+            }
+        }
+        log_sink_policy(output->sink, config);
+    }
+}
+
+int dlog_reload() {
+    char config_path[DEFAULT_FILEPATH_SIZE];
+    config_path_get(config_path, sizeof(config_path));
+    config_table_t* table = config_table_load(config_path);
+    if (!table) {
+        DLOG_ERROR_PRINT("Error opening config file: %s\n", config_path);
+        return -1;
+    }
+
+    // 持有 register_mutex，重新加载期间注册的实例要么在此之前创建并被遍历到，要么在此之后使用新配置
+    pthread_mutex_lock(&logger_ctl_inst.register_mutex);
+    pthread_mutex_lock(&config_ctl.mutex);
+    config_table_t* old_table = config_ctl.table;
+    config_ctl.table = table;
+    config_ctl.loaded = 1;
+    pthread_mutex_unlock(&config_ctl.mutex);
+    config_table_free(old_table);
+
+    for (logger_entry_t* entry = logger_ctl_inst.all; entry; entry = entry->all_next) {
+        logger_config_t config;
+        logger_config_default(&config);
+        logger_config_parse(table, entry->module_name, &config);
+        logger_reconfigure(entry->logger, entry->module_name, &config);
+    }
+    bg_config_apply(table, 0);
+    pthread_mutex_unlock(&logger_ctl_inst.register_mutex);
+    if (__atomic_load_n(&stats_ctl.interval_ms, __ATOMIC_RELAXED) > 0) {
+        pthread_once(&bg_thread_once, bg_thread_start);
+    }
+    return 0;
+}
+
+int dlog_get_stats(void *logger, struct dlog_stats *stats) {
+    if (!logger || !stats) return -1;
+    logger_t *log = (logger_t*)logger;
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < STATS_SHARDS; i++) {
+        const struct logger_stats_shard *shard = &log->stats[i];
+        for (int l = 0; l < DLOG_STATS_LEVELS; l++) {
+            stats->messages[l] += __atomic_load_n(&shard->messages[l], __ATOMIC_RELAXED);
+            stats->bytes[l] += __atomic_load_n(&shard->bytes[l], __ATOMIC_RELAXED);
+        }
+        stats->truncated += __atomic_load_n(&shard->truncated, __ATOMIC_RELAXED);
+        for (int b = 0; b < DLOG_STATS_BUCKETS; b++) {
+            stats->format_ns[b] += __atomic_load_n(&shard->format_ns[b], __ATOMIC_RELAXED);
+            stats->latency_ns[b] += __atomic_load_n(&shard->latency_ns[b], __ATOMIC_RELAXED);
+        }
+    }
+    stats->dropped = __atomic_load_n(&log->dropped, __ATOMIC_RELAXED);
+    stats->sync_fallbacks = __atomic_load_n(&log->sync_fallbacks, __ATOMIC_RELAXED);
+    for (int i = 0; i < log->output_count; i++) {
+        if (log->outputs[i].sink) {
+            stats->rotations += __atomic_load_n(&log->outputs[i].sink->rotations, __ATOMIC_RELAXED);
+        }
+    }
+    if (log->writer) {
+        uint64_t enqueued = __atomic_load_n(&log->writer->enqueue_pos, __ATOMIC_RELAXED);
+        uint64_t dequeued = __atomic_load_n(&log->writer->dequeue_pos, __ATOMIC_RELAXED);
+        stats->queue_depth = enqueued > dequeued ? (uint32_t)(enqueued - dequeued) : 0;
+        stats->queue_high_water = __atomic_load_n(&log->writer->high_water, __ATOMIC_RELAXED);
+    }
+    stats->pool_in_use = __atomic_load_n(&pool_outstanding, __ATOMIC_RELAXED);
+    stats->pool_high_water = __atomic_load_n(&pool_high_water, __ATOMIC_RELAXED);
+    return 0;
+}
+
+uint64_t dlog_stats_percentile(const uint64_t *histogram, double percentile) {
+    uint64_t total = 0;
+    for (int b = 0; b < DLOG_STATS_BUCKETS; b++) {
+        total += histogram[b];
+    }
+    if (total == 0) return 0;
+    // 第 rank 个样本（从 1 计）所在的桶
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (int b = 0; b < DLOG_STATS_BUCKETS; b++) {
+        seen += histogram[b];
+        if (seen >= rank) return b == 0 ? 0 : 1ULL << b;
+    }
+    return 1ULL << (DLOG_STATS_BUCKETS - 1);
 }
 
-#if (ASYNC_LOG)
 void fflush_async_log() {
-    // 发送信号以确保所有日志都被处理
-    pthread_mutex_lock(&log_mutex);
-    pthread_cond_signal(&log_cond);
-    pthread_mutex_unlock(&log_mutex);
-    // 等待异步线程处理完毕
-    async_thread_started = 0; // 停止线程
-    while (log_head->prev != log_tail) {
-        DLOG_DEBUG_PRINT("Waiting for async log thread to finish processing\n");
-        usleep(100 * 1000); // 100ms
+    // 等待每个写出线程处理完调用时刻之前入队的所有日志
+    for (int i = 0; i < async_ctl.count; i++) {
+        struct async_writer *writer = &async_ctl.writers[i];
+        uint64_t target = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_ACQUIRE);
+        while (__atomic_load_n(&writer->processed, __ATOMIC_ACQUIRE) < target) {
+            DLOG_DEBUG_PRINT("Waiting for async log thread %d to finish processing\n", i);
+            if (__atomic_exchange_n(&writer->consumer_sleeping, 0, __ATOMIC_ACQ_REL)) {
+                log_queue_wakeup(writer);
+            }
+            usleep(1000); // 1ms
+        }
     }
+    // 缓冲中的日志一并落盘
+    bg_flush_loggers(1);
+}
+
+// 处理完剩余日志后停止所有写出线程
+static void async_thread_stop() {
+    if (!async_ctl.ok) return;
+    fflush_async_log();
+    for (int i = 0; i < async_ctl.count; i++) {
+        struct async_writer *writer = &async_ctl.writers[i];
+        __atomic_store_n(&writer->running, 0, __ATOMIC_RELEASE);
+        log_queue_wakeup(writer);
+        pthread_join(writer->thread, NULL);
+        close(writer->wakeup_fd);
+    }
+    async_ctl.ok = 0;
+    async_ctl.count = 0;
+    free(async_ctl.writers);
+    async_ctl.writers = NULL;
 }
-#endif
 
 // lib 析构函数
 __attribute__((destructor))
 static void log_library_destructor() {
-#if (ASYNC_LOG)
-    fflush_async_log();
-#endif
+    bg_thread_stop();
+    bg_report_drops(1);
+    bg_report_suppressed(1);
+    async_thread_stop();
+    // 已入队的日志都已写出，崩溃日志环中不再有待写出的记录
+    dlog_journal_close();
+    compress_thread_stop();
     logger_ctl_free();
+    log_sink_ctl_free();
     // 释放日志缓冲区池
-    for (int i = 0; i < LOG_BUFFER_POOL_SIZE; i++){ 
-        if (pool[i].meta) {
-            free(pool[i].time_str);
-            free(pool[i].message);
-            free(pool[i].meta);
-            pool[i].meta = NULL;
-            pool[i].time_str = NULL;
-            pool[i].message = NULL;
-        }
+    buffer_cache.count = 0;
+    __atomic_store_n(&pool_free_head, (uint64_t)0, __ATOMIC_RELEASE);
+    __atomic_store_n(&pool_outstanding, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < LOG_BUFFER_POOL_SIZE; i++){
+        pool[i].meta = NULL;
+        pool[i].time_str = NULL;
+        pool[i].message = NULL;
+        pool[i].inline_message = NULL;
     }
-    pthread_mutex_destroy(&buffer_pool_mutex);
-}
\ No newline at end of file
+    if (pool_storage) {
+        munmap(pool_storage, pool_storage_size);
+    }
+    pool_storage = NULL;
+}
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(DLOG_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(DLOG_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "../include/dlog.h"
+#include "dlog_compress.h"
+
+/* 每次读入/写出的块大小，也是 CPU 预算的检查粒度 */
+#define COMPRESS_CHUNK_SIZE (64 * 1024)
+#define COMPRESS_GZIP_LEVEL 6
+#define COMPRESS_ZSTD_LEVEL 3
+
+int dlog_compress_supported(dlog_compress_type type) {
+    switch (type) {
+        case DLOG_COMPRESS_NONE: return 1;
+#if defined(DLOG_HAVE_ZLIB)
+        case DLOG_COMPRESS_GZIP: return 1;
+#endif
+#if defined(DLOG_HAVE_ZSTD)
+        case DLOG_COMPRESS_ZSTD: return 1;
+#endif
+        default: return 0;
+    }
+}
+
+const char* dlog_compress_suffix(dlog_compress_type type) {
+    switch (type) {
+        case DLOG_COMPRESS_GZIP: return ".gz";
+        case DLOG_COMPRESS_ZSTD: return ".zst";
+        default:                 return "";
+    }
+}
+
+static int64_t timespec_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* CPU 预算：线程 CPU 时间占墙钟时间的比例超过 cpu_percent 时休眠补足 */
+struct compress_budget {
+    int cpu_percent;
+    int64_t wall_start;
+    int64_t cpu_start;
+};
+
+static void budget_init(struct compress_budget* budget, int cpu_percent) {
+    budget->cpu_percent = cpu_percent;
+    budget->wall_start = timespec_ns(CLOCK_MONOTONIC);
+    budget->cpu_start = timespec_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+static void budget_throttle(const struct compress_budget* budget) {
+    if (budget->cpu_percent <= 0 || budget->cpu_percent >= 100) return;
+    int64_t cpu = timespec_ns(CLOCK_THREAD_CPUTIME_ID) - budget->cpu_start;
+    int64_t wall = timespec_ns(CLOCK_MONOTONIC) - budget->wall_start;
+    int64_t sleep_ns = cpu * 100 / budget->cpu_percent - wall;
+    if (sleep_ns > 0) {
+        struct timespec ts = { sleep_ns / 1000000000LL, sleep_ns % 1000000000LL };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static int write_all(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static ssize_t read_chunk(int fd, char* buffer) {
+    ssize_t n;
+    do {
+        n = read(fd, buffer, COMPRESS_CHUNK_SIZE);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+#define COMPRESS_CANCELLED(cancel) ((cancel) && __atomic_load_n((cancel), __ATOMIC_RELAXED))
+
+#if defined(DLOG_HAVE_ZLIB)
+static int compress_gzip(int in_fd, int out_fd, char* in_buf, char* out_buf,
+                         struct compress_budget* budget, const int* cancel) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // windowBits + 16 输出 gzip 格式
+    if (deflateInit2(&stream, COMPRESS_GZIP_LEVEL, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    int ret = 0;
+    int flush = Z_NO_FLUSH;
+    while (flush != Z_FINISH) {
+        ssize_t n = read_chunk(in_fd, in_buf);
+        if (n < 0 || COMPRESS_CANCELLED(cancel)) {
+            ret = -1;
+            break;
+        }
+        flush = n == 0 ? Z_FINISH : Z_NO_FLUSH;
+        stream.next_in = (Bytef*)in_buf;
+        stream.avail_in = (uInt)n;
+        do {
+            stream.next_out = (Bytef*)out_buf;
+            stream.avail_out = COMPRESS_CHUNK_SIZE;
+            if (deflate(&stream, flush) == Z_STREAM_ERROR ||
+                write_all(out_fd, out_buf, COMPRESS_CHUNK_SIZE - stream.avail_out) != 0) {
+                ret = -1;
+                break;
+            }
+        } while (stream.avail_out == 0);
+        if (ret != 0) break;
+        budget_throttle(budget);
+    }
+    deflateEnd(&stream);
+    return ret;
+}
+#endif
+
+#if defined(DLOG_HAVE_ZSTD)
+static int compress_zstd(int in_fd, int out_fd, char* in_buf, char* out_buf,
+                         struct compress_budget* budget, const int* cancel) {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    if (!cctx) return -1;
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, COMPRESS_ZSTD_LEVEL);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+    int ret = 0;
+    int finished = 0;
+    while (!finished) {
+        ssize_t n = read_chunk(in_fd, in_buf);
+        if (n < 0 || COMPRESS_CANCELLED(cancel)) {
+            ret = -1;
+            break;
+        }
+        ZSTD_EndDirective mode = n == 0 ? ZSTD_e_end : ZSTD_e_continue;
+        ZSTD_inBuffer input = { in_buf, (size_t)n, 0 };
+        size_t remaining;
+        do {
+            ZSTD_outBuffer output = { out_buf, COMPRESS_CHUNK_SIZE, 0 };
+            remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+            if (ZSTD_isError(remaining) || write_all(out_fd, out_buf, output.pos) != 0) {
+                ret = -1;
+                break;
+            }
+        } while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+        if (ret != 0) break;
+        finished = (mode == ZSTD_e_end);
+        budget_throttle(budget);
+    }
+    ZSTD_freeCCtx(cctx);
+    return ret;
+}
+#endif
+
+int dlog_compress_file(const char* path, dlog_compress_type type, int cpu_percent, const int* cancel) {
+    if (type == DLOG_COMPRESS_NONE || !dlog_compress_supported(type)) return -1;
+
+    size_t path_len = strlen(path);
+    const char* suffix = dlog_compress_suffix(type);
+    char* dst = (char*)malloc(path_len + strlen(suffix) + 1);
+    char* tmp = (char*)malloc(path_len + strlen(suffix) + sizeof(DLOG_COMPRESS_TMP_SUFFIX));
+    char* in_buf = (char*)malloc(COMPRESS_CHUNK_SIZE);
+    char* out_buf = (char*)malloc(COMPRESS_CHUNK_SIZE);
+    int in_fd = -1, out_fd = -1;
+    int ret = -1;
+    if (!dst || !tmp || !in_buf || !out_buf) goto out;
+    sprintf(dst, "%s%s", path, suffix);
+    sprintf(tmp, "%s%s", dst, DLOG_COMPRESS_TMP_SUFFIX);
+
+    in_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) goto out;
+    out_fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out_fd < 0) goto out;
+
+    struct compress_budget budget;
+    budget_init(&budget, cpu_percent);
+    switch (type) {
+#if defined(DLOG_HAVE_ZLIB)
+        case DLOG_COMPRESS_GZIP:
+            ret = compress_gzip(in_fd, out_fd, in_buf, out_buf, &budget, cancel);
+            break;
+#endif
+#if defined(DLOG_HAVE_ZSTD)
+        case DLOG_COMPRESS_ZSTD:
+            ret = compress_zstd(in_fd, out_fd, in_buf, out_buf, &budget, cancel);
+            break;
+#endif
+        default:
+            break;
+    }
+    // 压缩数据落盘后再链接到最终文件名，崩溃时只会留下 .tmp 中间文件或完整的压缩文件
+    if (ret == 0 && fsync(out_fd) != 0) ret = -1;
+    if (close(out_fd) != 0) ret = -1;
+    out_fd = -1;
+    // link 在目标已存在时失败，不会覆盖同名的已压缩文件（保留原文件）
+    if (ret == 0 && link(tmp, dst) != 0) {
+        ret = -1;
+        if (errno == EEXIST) {
+            DLOG_ERROR_PRINT("Compressed file already exists, %s stays uncompressed: %s\n", path, dst);
+        }
+    }
+    int saved_errno = errno;
+    unlink(tmp);
+    errno = saved_errno;
+    if (ret != 0) {
+        DLOG_DEBUG_PRINT("Compression of %s aborted (errno: %d)\n", path, errno);
+    } else if (unlink(path) != 0 && errno != ENOENT) {  // 原文件可能已被保留个数清理删除
+        DLOG_ERROR_PRINT("Failed to remove compressed log file: %s (errno: %d)\n", path, errno);
+    }
+
+out:
+    if (in_fd >= 0) close(in_fd);
+    if (out_fd >= 0) close(out_fd);
+    free(dst);
+    free(tmp);
+    free(in_buf);
+    free(out_buf);
+    return ret;
+}
@@ -0,0 +1,31 @@
+/**
+ * @brief: 滚动文件压缩：在后台低优先级线程中把 <file>.<时间>.<序号> 压缩为 .gz / .zst
+ * gzip 依赖 zlib（DLOG_HAVE_ZLIB），zstd 依赖 libzstd（DLOG_HAVE_ZSTD），由 Makefile 开关控制
+ */
+#ifndef DLOG_COMPRESS_H
+#define DLOG_COMPRESS_H
+
+typedef enum {
+    DLOG_COMPRESS_NONE = 0,
+    DLOG_COMPRESS_GZIP,
+    DLOG_COMPRESS_ZSTD
+} dlog_compress_type;
+
+/* 压缩中间文件的后缀，崩溃后残留的中间文件可直接删除 */
+#define DLOG_COMPRESS_TMP_SUFFIX ".tmp"
+
+/* 编译时是否支持该压缩方式 */
+int dlog_compress_supported(dlog_compress_type type);
+
+/* 压缩文件后缀（".gz" / ".zst"），不压缩时为空串 */
+const char* dlog_compress_suffix(dlog_compress_type type);
+
+/**
+ * 将 path 压缩为 path + 后缀：先写入 .tmp 中间文件并 fsync，再 link 为最终文件（已存在时失败，不覆盖），最后删除原文件；
+ * 任一步失败（或 *cancel 被置位）时删除中间文件并保留原文件。
+ * cpu_percent 为压缩线程可占用的 CPU 比例（1~99），超出时按比例休眠，<=0 或 >=100 表示不限。
+ * 成功返回 0，失败返回 -1。
+ */
+int dlog_compress_file(const char* path, dlog_compress_type type, int cpu_percent, const int* cancel);
+
+#endif //DLOG_COMPRESS_H
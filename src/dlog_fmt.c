@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "dlog_fmt.h"
+
+/* 单个转换说明的最大长度（含 % 和转换字符） */
+#define MAX_SPEC_SIZE 48
+
+/* 解析后的转换说明 */
+struct fmt_spec {
+    const char* start;      // 指向 '%'
+    const char* length;     // 长度修饰符起始位置
+    size_t length_len;      // 长度修饰符长度
+    const char* end;        // 转换字符之后
+    int width_star;         // 宽度为 *
+    int prec_star;          // 精度为 *
+    int prec;               // 数字精度，未指定为 -1
+    char conv;
+    dlog_arg_type type;     // 0 表示 %% 等不消耗参数的转换
+};
+
+// 解析 p（指向 '%'）处的转换说明，不支持延迟格式化时返回 -1
+static int fmt_parse_spec(const char* p, struct fmt_spec* spec) {
+    spec->start = p++;
+    spec->width_star = 0;
+    spec->prec_star = 0;
+    spec->prec = -1;
+    spec->type = 0;
+    if (*p == '%') {
+        spec->length = p;
+        spec->length_len = 0;
+        spec->conv = '%';
+        spec->end = p + 1;
+        return 0;
+    }
+    // 位置参数（%1$d）无法按顺序捕获
+    const char* q = p;
+    while (*q >= '0' && *q <= '9') q++;
+    if (*q == '$') return -1;
+
+    while (*p && strchr("-+ #0'I", *p)) p++;
+    if (*p == '*') {
+        spec->width_star = 1;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->prec_star = 1;
+            p++;
+        } else {
+            spec->prec = 0;
+            while (*p >= '0' && *p <= '9') {
+                spec->prec = spec->prec * 10 + (*p++ - '0');
+            }
+        }
+    }
+    spec->length = p;
+    if ((p[0] == 'h' && p[1] == 'h') || (p[0] == 'l' && p[1] == 'l')) {
+        p += 2;
+    } else if (*p && strchr("hlLqjzZt", *p)) {
+        p++;
+    }
+    spec->length_len = (size_t)(p - spec->length);
+    spec->conv = *p;
+    spec->end = p + 1;
+    if (spec->end - spec->start > MAX_SPEC_SIZE - 4) return -1;
+
+    int wide = spec->length_len > 0 && spec->length[0] != 'h';
+    switch (spec->conv) {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            spec->type = wide ? DLOG_ARG_I64 : DLOG_ARG_I32;
+            return 0;
+        case 'c':
+            spec->type = DLOG_ARG_I32;
+            return 0;
+        case 's':
+            if (spec->length_len > 0) return -1;  // %ls
+            spec->type = DLOG_ARG_STR;
+            return 0;
+        case 'p':
+            spec->type = DLOG_ARG_PTR;
+            return 0;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->type = (spec->length_len == 1 && spec->length[0] == 'L') ? DLOG_ARG_F128 : DLOG_ARG_F64;
+            return 0;
+        default:
+            return -1;  // %n、%m 以及未知转换
+    }
+}
+
+static int put_arg(char* out, size_t cap, size_t* pos, uint8_t type, const void* value, size_t size) {
+    if (*pos + 1 + size > cap) return -1;
+    out[(*pos)++] = (char)type;
+    if (size > 0) memcpy(out + *pos, value, size);
+    *pos += size;
+    return 0;
+}
+
+int dlog_fmt_capture(char* out, size_t cap, const char* format, va_list args) {
+    size_t pos = 0;
+    const char* p = format;
+    while ((p = strchr(p, '%')) != NULL) {
+        struct fmt_spec spec;
+        if (fmt_parse_spec(p, &spec) != 0) return -1;
+        p = spec.end;
+        if (spec.type == 0) continue;
+
+        int prec = spec.prec;
+        if (spec.width_star) {
+            int width = va_arg(args, int);
+            if (put_arg(out, cap, &pos, DLOG_ARG_I32, &width, sizeof(width)) != 0) return -1;
+        }
+        if (spec.prec_star) {
+            prec = va_arg(args, int);
+            if (put_arg(out, cap, &pos, DLOG_ARG_I32, &prec, sizeof(prec)) != 0) return -1;
+        }
+        switch (spec.type) {
+            case DLOG_ARG_I32: {
+                int value = va_arg(args, int);
+                if (put_arg(out, cap, &pos, DLOG_ARG_I32, &value, sizeof(value)) != 0) return -1;
+                break;
+            }
+            case DLOG_ARG_I64: {
+                long long value = va_arg(args, long long);
+                if (put_arg(out, cap, &pos, DLOG_ARG_I64, &value, sizeof(value)) != 0) return -1;
+                break;
+            }
+            case DLOG_ARG_F64: {
+                double value = va_arg(args, double);
+                if (put_arg(out, cap, &pos, DLOG_ARG_F64, &value, sizeof(value)) != 0) return -1;
+                break;
+            }
+            case DLOG_ARG_F128: {
+                long double value = va_arg(args, long double);
+                if (put_arg(out, cap, &pos, DLOG_ARG_F128, &value, sizeof(value)) != 0) return -1;
+                break;
+            }
+            case DLOG_ARG_PTR: {
+                void* value = va_arg(args, void*);
+                if (put_arg(out, cap, &pos, DLOG_ARG_PTR, &value, sizeof(value)) != 0) return -1;
+                break;
+            }
+            default: {
+                const char* value = va_arg(args, const char*);
+                if (!value) {
+                    if (put_arg(out, cap, &pos, DLOG_ARG_NULL_STR, NULL, 0) != 0) return -1;
+                    break;
+                }
+                // 指定了精度时字符串不要求以 NUL 结尾，只拷贝会被输出的部分
+                uint32_t len = (uint32_t)(prec >= 0 ? strnlen(value, (size_t)prec) : strlen(value));
+                if (put_arg(out, cap, &pos, DLOG_ARG_STR, &len, sizeof(len)) != 0) return -1;
+                if (pos + len + 1 > cap) return -1;
+                memcpy(out + pos, value, len);
+                out[pos + len] = '\0';
+                pos += len + 1;
+                break;
+            }
+        }
+    }
+    return (int)pos;
+}
+
+// 按标记读取一个参数，标记不符或数据不足返回 NULL
+static const char* get_arg(const char* args, size_t args_len, size_t* pos, uint8_t type, size_t size) {
+    if (*pos + 1 + size > args_len || (uint8_t)args[*pos] != type) return NULL;
+    const char* value = args + *pos + 1;
+    *pos += 1 + size;
+    return value;
+}
+
+int dlog_fmt_render(char* out, size_t cap, const char* format, const char* args, size_t args_len) {
+    size_t total = 0;
+    size_t pos = 0;
+    const char* p = format;
+    while (*p) {
+        const char* next = strchr(p, '%');
+        size_t literal = next ? (size_t)(next - p) : strlen(p);
+        if (total < cap && literal > 0) {
+            size_t room = cap - total - 1;
+            memcpy(out + total, p, literal < room ? literal : room);
+        }
+        total += literal;
+        if (!next) break;
+
+        struct fmt_spec spec;
+        if (fmt_parse_spec(next, &spec) != 0) return -1;
+        p = spec.end;
+        if (spec.type == 0) {
+            if (total + 1 < cap) out[total] = '%';
+            total++;
+            continue;
+        }
+
+        // 重建转换说明：统一长度修饰符，使参数类型与捕获时一致
+        char spec_str[MAX_SPEC_SIZE];
+        size_t head = (size_t)(spec.length - spec.start);
+        memcpy(spec_str, spec.start, head);
+        if (spec.type == DLOG_ARG_I64) {
+            memcpy(spec_str + head, "ll", 2);
+            head += 2;
+        } else if (spec.type == DLOG_ARG_I32 || spec.type == DLOG_ARG_F128) {
+            memcpy(spec_str + head, spec.length, spec.length_len);
+            head += spec.length_len;
+        }
+        spec_str[head++] = spec.conv;
+        spec_str[head] = '\0';
+
+        int star[2];
+        int nstar = 0;
+        const char* value;
+        for (int i = 0; i < spec.width_star + spec.prec_star; i++) {
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_I32, sizeof(int)))) return -1;
+            memcpy(&star[nstar++], value, sizeof(int));
+        }
+        char* dst = total < cap ? out + total : NULL;
+        size_t room = total < cap ? cap - total : 0;
+        int written;
+#define FMT_CALL(arg) (nstar == 0 ? snprintf(dst, room, spec_str, arg) :               \
+                       nstar == 1 ? snprintf(dst, room, spec_str, star[0], arg) :      \
+                                    snprintf(dst, room, spec_str, star[0], star[1], arg))
+        if (pos < args_len && (uint8_t)args[pos] == DLOG_ARG_NULL_STR && spec.type == DLOG_ARG_STR) {
+            pos++;
+            written = FMT_CALL((const char*)NULL);
+        } else if (spec.type == DLOG_ARG_I32) {
+            int v;
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_I32, sizeof(v)))) return -1;
+            memcpy(&v, value, sizeof(v));
+            written = FMT_CALL(v);
+        } else if (spec.type == DLOG_ARG_I64) {
+            long long v;
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_I64, sizeof(v)))) return -1;
+            memcpy(&v, value, sizeof(v));
+            written = FMT_CALL(v);
+        } else if (spec.type == DLOG_ARG_F64) {
+            double v;
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_F64, sizeof(v)))) return -1;
+            memcpy(&v, value, sizeof(v));
+            written = FMT_CALL(v);
+        } else if (spec.type == DLOG_ARG_F128) {
+            long double v;
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_F128, sizeof(v)))) return -1;
+            memcpy(&v, value, sizeof(v));
+            written = FMT_CALL(v);
+        } else if (spec.type == DLOG_ARG_PTR) {
+            void* v;
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_PTR, sizeof(v)))) return -1;
+            memcpy(&v, value, sizeof(v));
+            written = FMT_CALL(v);
+        } else {
+            uint32_t len;
+            if (!(value = get_arg(args, args_len, &pos, DLOG_ARG_STR, sizeof(len)))) return -1;
+            memcpy(&len, value, sizeof(len));
+            if (pos + len + 1 > args_len) return -1;
+            written = FMT_CALL(args + pos);
+            pos += len + 1;
+        }
+#undef FMT_CALL
+        if (written < 0) return -1;
+        total += (size_t)written;
+    }
+    if (cap > 0) {
+        out[total < cap ? total : cap - 1] = '\0';
+    }
+    return (int)total;
+}
@@ -0,0 +1,52 @@
+/**
+ * @brief: 延迟格式化：生产者只按格式串捕获原始参数，写出时（异步线程或解码工具）再格式化
+ */
+#ifndef DLOG_FMT_H
+#define DLOG_FMT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* 捕获参数的类型标记，每个参数在记录中以 1 字节标记开头 */
+typedef enum {
+    DLOG_ARG_I32 = 1,   // int 及更窄的整数、char、wint_t
+    DLOG_ARG_I64,       // long、long long、intmax_t、size_t、ptrdiff_t
+    DLOG_ARG_F64,       // double
+    DLOG_ARG_F128,      // long double
+    DLOG_ARG_PTR,       // %p
+    DLOG_ARG_STR,       // %s，后跟 uint32 长度和字符串内容
+    DLOG_ARG_NULL_STR   // %s 的 NULL 参数
+} dlog_arg_type;
+
+/*
+ * 二进制日志文件格式（本机字节序）：
+ *   文件头：DLOG_BIN_MAGIC
+ *   格式串定义：'F' | uint32 id | uint32 长度 | 格式串（不含 NUL）
+ *   日志条目：  'E' | uint8 等级 | int64 秒 | uint32 纳秒 | uint32 格式串 id | uint32 参数长度 | 捕获的参数
+ *   文本条目：  'M' | uint8 等级 | int64 秒 | uint32 纳秒 | uint32 长度 | 已格式化的消息
+ * 同一文件中格式串 id 可被后出现的定义覆盖（如进程重启后续写）。
+ */
+#define DLOG_BIN_MAGIC "DLOGBIN1"
+#define DLOG_BIN_MAGIC_LEN 8
+#define DLOG_BIN_FORMAT 'F'
+#define DLOG_BIN_ENTRY 'E'
+#define DLOG_BIN_TEXT 'M'
+#define DLOG_BIN_FORMAT_HEAD_LEN 9
+#define DLOG_BIN_ENTRY_HEAD_LEN 22
+#define DLOG_BIN_TEXT_HEAD_LEN 18
+
+/**
+ * 按格式串从 args 中捕获参数到 out（字符串会被拷贝）。
+ * 返回使用的字节数；格式串含不支持延迟格式化的转换（%n、%m、%ls、位置参数）
+ * 或 out 空间不足时返回 -1，调用方应改为立即格式化。
+ */
+int dlog_fmt_capture(char* out, size_t cap, const char* format, va_list args);
+
+/**
+ * 用捕获的参数渲染格式串，语义同 snprintf：
+ * 最多写入 cap - 1 个字符并以 NUL 结尾，返回完整输出所需的长度，出错返回 -1。
+ */
+int dlog_fmt_render(char* out, size_t cap, const char* format, const char* args, size_t args_len);
+
+#endif //DLOG_FMT_H
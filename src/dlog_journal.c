@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "../include/dlog.h"
+#include "dlog_journal.h"
+
+/* 数据区在文件中的偏移（文件头按页对齐） */
+#define JOURNAL_DATA_OFFSET ((sizeof(struct dlog_journal_header) + 4095) & ~(size_t)4095)
+#define JOURNAL_MIN_CAPACITY (64 * 1024)
+/* 在线补写时等待其他线程写好已预留记录头部的最大轮询次数 */
+#define JOURNAL_SPIN_LIMIT (1 << 20)
+
+static struct {
+    int fd;
+    struct dlog_journal_header* header;     // NULL 表示未打开，信号处理函数据此判断
+    char* data;
+    size_t map_size;
+    pthread_mutex_t mutex;  // 文件登记和回收
+    int handler_installed;
+} journal = {
+    .fd = -1,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const int journal_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+#define JOURNAL_SIGNAL_COUNT ((int)(sizeof(journal_signals) / sizeof(journal_signals[0])))
+static struct sigaction journal_old_actions[JOURNAL_SIGNAL_COUNT];
+
+// 把 [tail, head) 中待写出的记录（已渲染好的整行）追加到各自的文件并标记完成；
+// wait 非零时（在线补写）等待其他线程写好已预留记录的头部，否则遇到未写入的记录即停止
+static int journal_flush_pending(struct dlog_journal_header* header, char* data, int wait) {
+    int fds[DLOG_JOURNAL_MAX_FILES];
+    for (int i = 0; i < DLOG_JOURNAL_MAX_FILES; i++) {
+        fds[i] = -1;
+    }
+    uint64_t capacity = header->capacity;
+    uint32_t file_count = __atomic_load_n(&header->file_count, __ATOMIC_ACQUIRE);
+    if (file_count > DLOG_JOURNAL_MAX_FILES) file_count = DLOG_JOURNAL_MAX_FILES;
+    uint64_t pos = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (head - pos > capacity) pos = head - capacity;
+    int written = 0;
+    while (pos < head) {
+        uint64_t off = pos % capacity;
+        if (capacity - off < sizeof(struct dlog_journal_record)) {
+            pos += capacity - off;
+            continue;
+        }
+        struct dlog_journal_record* record = (struct dlog_journal_record*)(data + off);
+        uint32_t state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+        for (int spin = 0; state == DLOG_JOURNAL_FREE && wait && spin < JOURNAL_SPIN_LIMIT; spin++) {
+            state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+        }
+        uint32_t size = record->size;
+        if (state == DLOG_JOURNAL_FREE || size < sizeof(struct dlog_journal_record) || size > capacity - off) {
+            break;
+        }
+        if (state == DLOG_JOURNAL_COMMITTED && record->len <= size - sizeof(struct dlog_journal_record)) {
+            for (uint64_t mask = record->files; mask; mask &= mask - 1) {
+                uint32_t k = (uint32_t)__builtin_ctzll(mask);
+                if (k >= file_count) break;
+                if (fds[k] < 0) {
+                    fds[k] = open(header->files[k], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+                }
+                // 一次 write 追加整行，与仍在运行的写出线程交错时不会拆开一行
+                if (fds[k] >= 0 && write(fds[k], record + 1, record->len) < 0) {
+                    close(fds[k]);
+                    fds[k] = -1;
+                }
+            }
+            __atomic_store_n(&record->state, DLOG_JOURNAL_DONE, __ATOMIC_RELEASE);
+            written++;
+        }
+        pos += size;
+    }
+    for (int i = 0; i < DLOG_JOURNAL_MAX_FILES; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+    return written;
+}
+
+// 补写 fd 中残留的待写出记录；不是日志环文件（过短或文件头无效）时返回 -1，errno 为 EINVAL
+static int journal_recover_fd(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    if ((size_t)st.st_size < JOURNAL_DATA_OFFSET) {
+        errno = EINVAL;
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) return -1;
+    struct dlog_journal_header* header = (struct dlog_journal_header*)map;
+    int recovered = -1;
+    if (memcmp(header->magic, DLOG_JOURNAL_MAGIC, sizeof(header->magic)) == 0 &&
+        header->capacity >= JOURNAL_MIN_CAPACITY && header->capacity % 8 == 0 &&
+        JOURNAL_DATA_OFFSET + header->capacity <= (uint64_t)st.st_size) {
+        recovered = journal_flush_pending(header, (char*)map + JOURNAL_DATA_OFFSET, 0);
+    }
+    munmap(map, (size_t)st.st_size);
+    if (recovered < 0) errno = EINVAL;
+    return recovered;
+}
+
+int dlog_journal_open(const char* path, uint64_t size) {
+    if (journal.header) return 0;
+    uint64_t capacity = size & ~(uint64_t)7;
+    if (capacity < JOURNAL_MIN_CAPACITY) capacity = JOURNAL_MIN_CAPACITY;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        DLOG_ERROR_PRINT("Error opening crash journal: %s (errno: %d)\n", path, errno);
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        DLOG_ERROR_PRINT("Crash journal %s is in use by another process\n", path);
+        close(fd);
+        return -1;
+    }
+    // 新建的空文件直接使用；已有内容时必须是日志环，否则拒绝使用，不清空别的文件
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        DLOG_ERROR_PRINT("Error opening crash journal: %s (errno: %d)\n", path, errno);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        int recovered = journal_recover_fd(fd);
+        if (recovered < 0) {
+            if (errno == EINVAL) {
+                DLOG_ERROR_PRINT("%s is not a crash journal, crash journal disabled\n", path);
+            } else {
+                DLOG_ERROR_PRINT("Error reading crash journal: %s (errno: %d)\n", path, errno);
+            }
+            close(fd);
+            return -1;
+        }
+        if (recovered > 0) {
+            DLOG_ERROR_PRINT("Recovered %d log lines from crash journal %s\n", recovered, path);
+        }
+    }
+    // 截断后重新扩展，数据区全部清零
+    size_t map_size = JOURNAL_DATA_OFFSET + capacity;
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)map_size) != 0) {
+        DLOG_ERROR_PRINT("Error sizing crash journal: %s (errno: %d)\n", path, errno);
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        DLOG_ERROR_PRINT("Error mapping crash journal: %s (errno: %d)\n", path, errno);
+        close(fd);
+        return -1;
+    }
+    struct dlog_journal_header* header = (struct dlog_journal_header*)map;
+    memcpy(header->magic, DLOG_JOURNAL_MAGIC, sizeof(header->magic));
+    header->capacity = capacity;
+    journal.fd = fd;
+    journal.data = (char*)map + JOURNAL_DATA_OFFSET;
+    journal.map_size = map_size;
+    __atomic_store_n(&journal.header, header, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int dlog_journal_active() {
+    return __atomic_load_n(&journal.header, __ATOMIC_ACQUIRE) != NULL;
+}
+
+int dlog_journal_file(const char* path) {
+    struct dlog_journal_header* header = __atomic_load_n(&journal.header, __ATOMIC_ACQUIRE);
+    if (!header || strlen(path) >= DLOG_JOURNAL_PATH_SIZE) return -1;
+    pthread_mutex_lock(&journal.mutex);
+    uint32_t count = header->file_count;
+    int index = -1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(header->files[i], path) == 0) {
+            index = (int)i;
+            break;
+        }
+    }
+    if (index < 0 && count < DLOG_JOURNAL_MAX_FILES) {
+        strcpy(header->files[count], path);
+        // 路径写完后再发布
+        __atomic_store_n(&header->file_count, count + 1, __ATOMIC_RELEASE);
+        index = (int)count;
+    }
+    pthread_mutex_unlock(&journal.mutex);
+    if (index < 0) {
+        DLOG_ERROR_PRINT("Crash journal file table full, %s is not covered\n", path);
+    }
+    return index;
+}
+
+uint64_t dlog_journal_append(uint64_t files, const struct iovec* iov, int iovcnt) {
+    struct dlog_journal_header* header = __atomic_load_n(&journal.header, __ATOMIC_ACQUIRE);
+    if (!header) return 0;
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    if (total > UINT32_MAX) return 0;
+    uint32_t len = (uint32_t)total;
+    uint64_t capacity = header->capacity;
+    uint64_t size = (sizeof(struct dlog_journal_record) + len + 7) & ~(uint64_t)7;
+    if (size > capacity / 4) return 0;
+    // 预留空间：环尾放不下整条记录时连同剩余部分一起预留，记录从环首开始
+    uint64_t head = __atomic_load_n(&header->head, __ATOMIC_RELAXED);
+    uint64_t pos;
+    do {
+        uint64_t off = head % capacity;
+        pos = capacity - off < size ? head + (capacity - off) : head;
+        if (pos + size - __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE) > capacity) return 0;
+    } while (!__atomic_compare_exchange_n(&header->head, &head, pos + size, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    if (pos != head && capacity - head % capacity >= sizeof(struct dlog_journal_record)) {
+        struct dlog_journal_record* pad = (struct dlog_journal_record*)(journal.data + head % capacity);
+        pad->size = (uint32_t)(capacity - head % capacity);
+        pad->files = 0;
+        __atomic_store_n(&pad->state, DLOG_JOURNAL_DONE, __ATOMIC_RELEASE);
+    }
+    struct dlog_journal_record* record = (struct dlog_journal_record*)(journal.data + pos % capacity);
+    record->size = (uint32_t)size;
+    __atomic_store_n(&record->state, DLOG_JOURNAL_WRITING, __ATOMIC_RELEASE);
+    record->files = files;
+    record->len = len;
+    char* p = (char*)(record + 1);
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(p, iov[i].iov_base, iov[i].iov_len);
+        p += iov[i].iov_len;
+    }
+    __atomic_store_n(&record->state, DLOG_JOURNAL_COMMITTED, __ATOMIC_RELEASE);
+    return pos + 1;
+}
+
+void dlog_journal_done(uint64_t ref) {
+    struct dlog_journal_header* header = __atomic_load_n(&journal.header, __ATOMIC_ACQUIRE);
+    if (!header || ref == 0) return;
+    struct dlog_journal_record* record = (struct dlog_journal_record*)(journal.data + (ref - 1) % header->capacity);
+    __atomic_store_n(&record->state, DLOG_JOURNAL_DONE, __ATOMIC_RELEASE);
+}
+
+void dlog_journal_reclaim() {
+    struct dlog_journal_header* header = __atomic_load_n(&journal.header, __ATOMIC_ACQUIRE);
+    if (!header || pthread_mutex_trylock(&journal.mutex) != 0) return;
+    uint64_t capacity = header->capacity;
+    uint64_t tail = header->tail;
+    uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    while (tail < head) {
+        uint64_t off = tail % capacity;
+        if (capacity - off < sizeof(struct dlog_journal_record)) {
+            tail += capacity - off;
+            continue;
+        }
+        struct dlog_journal_record* record = (struct dlog_journal_record*)(journal.data + off);
+        if (__atomic_load_n(&record->state, __ATOMIC_ACQUIRE) != DLOG_JOURNAL_DONE) break;
+        // 整条清零：之后在这里预留的记录写好头部之前，扫描者只会读到 FREE
+        uint32_t size = record->size;
+        memset(record, 0, size);
+        tail += size;
+    }
+    __atomic_store_n(&header->tail, tail, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&journal.mutex);
+}
+
+int dlog_journal_drain() {
+    struct dlog_journal_header* header = __atomic_load_n(&journal.header, __ATOMIC_ACQUIRE);
+    if (!header) return 0;
+    return journal_flush_pending(header, journal.data, 1);
+}
+
+static void journal_signal_handler(int sig) {
+    int saved_errno = errno;
+    dlog_journal_drain();
+    for (int i = 0; i < JOURNAL_SIGNAL_COUNT; i++) {
+        if (journal_signals[i] == sig) {
+            sigaction(sig, &journal_old_actions[i], NULL);
+        }
+    }
+    errno = saved_errno;
+    raise(sig);
+}
+
+void dlog_journal_install_handler() {
+    if (journal.handler_installed) return;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = journal_signal_handler;
+    action.sa_flags = SA_ONSTACK;   // 栈溢出时可使用程序设置的备用信号栈
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < JOURNAL_SIGNAL_COUNT; i++) {
+        sigaction(journal_signals[i], &action, &journal_old_actions[i]);
+    }
+    journal.handler_installed = 1;
+}
+
+void dlog_journal_close() {
+    struct dlog_journal_header* header = __atomic_exchange_n(&journal.header, NULL, __ATOMIC_ACQ_REL);
+    if (journal.handler_installed) {
+        for (int i = 0; i < JOURNAL_SIGNAL_COUNT; i++) {
+            sigaction(journal_signals[i], &journal_old_actions[i], NULL);
+        }
+        journal.handler_installed = 0;
+    }
+    if (!header) return;
+    munmap(header, journal.map_size);
+    close(journal.fd);
+    journal.fd = -1;
+    journal.data = NULL;
+}
+
+int dlog_journal_recover(const char* path) {
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return -1;
+    // 仍被运行中的进程持有时不处理，避免与其写出线程重复写出
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        errno = EBUSY;
+        return -1;
+    }
+    // 只在确认是日志环并补写后清空
+    int recovered = journal_recover_fd(fd);
+    if (recovered >= 0 && ftruncate(fd, 0) != 0) recovered = -1;
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return recovered;
+}
@@ -0,0 +1,75 @@
+/**
+ * @brief: 崩溃日志环：异步实例的日志在入队时同时写入一个文件映射的共享内存环，写出到文件后标记完成；
+ * 进程崩溃时由信号处理函数、下次启动时由库本身或 dlog_recover 工具把尚未写出的日志补写到各自的文件
+ */
+#ifndef DLOG_JOURNAL_H
+#define DLOG_JOURNAL_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define DLOG_JOURNAL_MAGIC "DLOGJRN2"
+#define DLOG_JOURNAL_MAX_FILES 64       // 文件表大小，记录用位图标出写往的文件
+#define DLOG_JOURNAL_PATH_SIZE 256
+
+/* 记录状态 */
+#define DLOG_JOURNAL_FREE      0   // 未写入（或已回收）
+#define DLOG_JOURNAL_WRITING   1   // 生产者正在拷贝
+#define DLOG_JOURNAL_COMMITTED 2   // 待写出
+#define DLOG_JOURNAL_DONE      3   // 已写出到文件（或环尾的填充），可回收
+
+/* 文件头：数据区紧随其后，head / tail 为单调递增的字节位置，对 capacity 取模得到偏移 */
+struct dlog_journal_header {
+    char magic[8];
+    uint64_t capacity;      // 数据区字节数
+    uint64_t head;          // 已预留到的位置
+    uint64_t tail;          // 已回收到的位置
+    uint32_t file_count;
+    uint32_t reserved;
+    char files[DLOG_JOURNAL_MAX_FILES][DLOG_JOURNAL_PATH_SIZE];    // 绝对路径
+};
+
+/* 记录头：8 字节对齐，按实例的时间格式和调用点前缀渲染好的整行（含换行）紧随其后，补写时原样写出 */
+struct dlog_journal_record {
+    uint32_t state;
+    uint32_t size;          // 整条记录占用的字节数（含对齐）
+    uint64_t files;         // 写往的文件（文件表下标位图）
+    uint32_t len;           // 整行字节数
+    uint32_t reserved;
+};
+
+/**
+ * 打开（不存在时创建）path 作为本进程的崩溃日志环，数据区 size 字节；文件中残留上次运行未写出的日志时先补写。
+ * 同一文件同时只能被一个进程使用（flock）；path 已有内容但不是日志环文件时拒绝使用且不改动它。成功返回 0
+ */
+int dlog_journal_open(const char* path, uint64_t size);
+
+/* 是否已打开 */
+int dlog_journal_active();
+
+/* 登记输出文件（绝对路径），返回文件表下标；表已满或未打开时返回 -1 */
+int dlog_journal_file(const char* path);
+
+/* 追加一条待写出的记录，内容为 iov 依次拼接成的整行；返回记录引用（0 表示环已满或行过长，未记录） */
+uint64_t dlog_journal_append(uint64_t files, const struct iovec* iov, int iovcnt);
+
+/* 记录已写出到文件 */
+void dlog_journal_done(uint64_t ref);
+
+/* 回收环尾已完成的记录；可在任意线程调用，忙时直接返回 */
+void dlog_journal_reclaim();
+
+/* 异步信号安全：把待写出的记录直接 write 到各自的文件并标记完成，返回补写的条数 */
+int dlog_journal_drain();
+
+/* 为 SIGSEGV / SIGBUS / SIGILL / SIGFPE / SIGABRT 安装处理函数：补写后恢复原处理方式并重新发出信号 */
+void dlog_journal_install_handler();
+
+/* 解除映射并关闭（保留文件，待写出记录仍在其中） */
+void dlog_journal_close();
+
+/* 离线补写 path 中待写出的记录并清空，供 dlog_recover 使用；返回补写的条数，失败返回 -1。
+ * path 不是日志环文件时 errno 为 EINVAL，文件保持原样 */
+int dlog_journal_recover(const char* path);
+
+#endif //DLOG_JOURNAL_H
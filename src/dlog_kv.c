@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "dlog_kv.h"
+#include "dlog_typed.h"
+
+/* 按 snprintf 语义累计输出：空间不足时截断，但继续累计所需长度 */
+struct kv_writer {
+    char* out;
+    size_t cap;
+    size_t total;
+};
+
+static inline void put(struct kv_writer* w, const char* data, size_t len) {
+    if (w->total + 1 < w->cap) {
+        size_t room = w->cap - w->total - 1;
+        memcpy(w->out + w->total, data, len < room ? len : room);
+    }
+    w->total += len;
+}
+
+static inline void put_char(struct kv_writer* w, char c) {
+    if (w->total + 1 < w->cap) w->out[w->total] = c;
+    w->total++;
+}
+
+static int kv_finish(struct kv_writer* w) {
+    if (w->cap > 0) {
+        w->out[w->total < w->cap ? w->total : w->cap - 1] = '\0';
+    }
+    return (int)w->total;
+}
+
+// 转义引号、反斜杠和控制字符（JSON 规则，logfmt 的带引号值沿用），其余字节原样拷贝
+static void put_escaped(struct kv_writer* w, const char* s, size_t len) {
+    static const char hex_digits[] = "0123456789abcdef";
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        put(w, s + start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"':  put(w, "\\\"", 2); break;
+            case '\\': put(w, "\\\\", 2); break;
+            case '\n': put(w, "\\n", 2); break;
+            case '\r': put(w, "\\r", 2); break;
+            case '\t': put(w, "\\t", 2); break;
+            default: {
+                char u[6] = { '\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xf] };
+                put(w, u, sizeof(u));
+                break;
+            }
+        }
+    }
+    put(w, s + start, len - start);
+}
+
+// logfmt 的值含空格、等号、引号或控制字符（或为空）时需加引号
+static int logfmt_needs_quote(const char* s, size_t len) {
+    if (len == 0) return 1;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c <= ' ' || c == '=' || c == '"' || c == '\\') return 1;
+    }
+    return 0;
+}
+
+static void put_string(struct kv_writer* w, int format, const char* s, size_t len) {
+    if (format == DLOG_FORMAT_JSON || logfmt_needs_quote(s, len)) {
+        put_char(w, '"');
+        put_escaped(w, s, len);
+        put_char(w, '"');
+    } else {
+        put(w, s, len);
+    }
+}
+
+// logfmt 的键不能加引号：空格、等号、引号、反斜杠和控制字符替换为 '_'，空键写作 '_'，保证整行仍可解析
+static void put_logfmt_key(struct kv_writer* w, const char* key, size_t len) {
+    if (len == 0) {
+        put_char(w, '_');
+        return;
+    }
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)key[i];
+        if (c > ' ' && c != '=' && c != '"' && c != '\\') continue;
+        put(w, key + start, i - start);
+        put_char(w, '_');
+        start = i + 1;
+    }
+    put(w, key + start, len - start);
+}
+
+static void put_key(struct kv_writer* w, int format, const char* key) {
+    if (!key) key = "";
+    if (format == DLOG_FORMAT_JSON) {
+        put_char(w, '"');
+        put_escaped(w, key, strlen(key));
+        put(w, "\":", 2);
+    } else {
+        put_logfmt_key(w, key, strlen(key));
+        put_char(w, '=');
+    }
+}
+
+// 数值直接渲染到输出的剩余空间，按返回的实际长度累计，不经过定长的中间缓冲
+static void put_rendered(struct kv_writer* w, const struct dlog_value* value) {
+    size_t room = w->total < w->cap ? w->cap - w->total : 0;
+    int len = dlog_typed_render(room ? w->out + w->total : NULL, room, value, 1);
+    if (len > 0) w->total += (size_t)len;
+}
+
+static void put_value(struct kv_writer* w, int format, const struct dlog_value* value) {
+    int json = (format == DLOG_FORMAT_JSON);
+    switch (value->type) {
+        case DLOG_VALUE_STR:
+            if (!value->v.s) {
+                put(w, "null", 4);
+            } else {
+                put_string(w, format, value->v.s, strlen(value->v.s));
+            }
+            return;
+        case DLOG_VALUE_CHAR: {
+            char c = (char)value->v.i;
+            put_string(w, format, &c, 1);
+            return;
+        }
+        case DLOG_VALUE_FLOAT:
+            // JSON 没有 NaN / Infinity
+            if (json && !(value->v.f - value->v.f == 0)) {
+                put(w, "null", 4);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    // 十六进制和指针在 JSON 中按字符串输出
+    if (json && (value->type == DLOG_VALUE_HEX || value->type == DLOG_VALUE_PTR)) {
+        put_char(w, '"');
+        put_rendered(w, value);
+        put_char(w, '"');
+    } else {
+        put_rendered(w, value);
+    }
+}
+
+int dlog_kv_render(char* out, size_t cap, int format, const char* msg, size_t msg_len,
+                   const struct dlog_value* kvs, int count) {
+    struct kv_writer w = { out, cap, 0 };
+    if (format == DLOG_FORMAT_TEXT) {
+        put(&w, msg, msg_len);
+    } else {
+        put_key(&w, format, "msg");
+        put_string(&w, format, msg, msg_len);
+    }
+    for (int i = 0; i < count; i += 2) {
+        const char* key = kvs[i].type == DLOG_VALUE_STR ? kvs[i].v.s : NULL;
+        put_char(&w, format == DLOG_FORMAT_JSON ? ',' : ' ');
+        put_key(&w, format, key);
+        if (i + 1 < count) {
+            put_value(&w, format, &kvs[i + 1]);
+        } else {
+            put(&w, "null", 4);
+        }
+    }
+    return kv_finish(&w);
+}
+
+int dlog_kv_site(char* out, size_t cap, int format, int pid, int tid, const char* file, const char* func, int line) {
+    struct kv_writer w = { out, cap, 0 };
+    char sep = format == DLOG_FORMAT_JSON ? ',' : ' ';
+    struct dlog_value ids[3] = { dlog_value_int(pid), dlog_value_int(tid), dlog_value_int(line) };
+    put_key(&w, format, "pid");
+    put_value(&w, format, &ids[0]);
+    put_char(&w, sep);
+    put_key(&w, format, "tid");
+    put_value(&w, format, &ids[1]);
+    put_char(&w, sep);
+    put_key(&w, format, "file");
+    put_string(&w, format, file, strlen(file));
+    put_char(&w, sep);
+    put_key(&w, format, "func");
+    put_string(&w, format, func, strlen(func));
+    put_char(&w, sep);
+    put_key(&w, format, "line");
+    put_value(&w, format, &ids[2]);
+    put_char(&w, sep);
+    return kv_finish(&w);
+}
+
+int dlog_kv_level(char* out, size_t cap, int format, const char* level, const char* logger_name) {
+    struct kv_writer w = { out, cap, 0 };
+    // 紧接在带引号的时间之后
+    put(&w, format == DLOG_FORMAT_JSON ? "\"," : "\" ", 2);
+    put_key(&w, format, "level");
+    put_string(&w, format, level, strlen(level));
+    put_char(&w, format == DLOG_FORMAT_JSON ? ',' : ' ');
+    put_key(&w, format, "logger");
+    put_string(&w, format, logger_name, strlen(logger_name));
+    put_char(&w, format == DLOG_FORMAT_JSON ? ',' : ' ');
+    return kv_finish(&w);
+}
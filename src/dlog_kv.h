@@ -0,0 +1,30 @@
+/**
+ * @brief: 结构化日志编码：消息和键值对编码为 text / json / logfmt，字符串转义、数值不经过 printf
+ */
+#ifndef DLOG_KV_H
+#define DLOG_KV_H
+
+#include <stddef.h>
+
+#include "../include/dlog.h"
+
+/* 日志行格式（logger.X.format） */
+#define DLOG_FORMAT_TEXT   0   // time [LEVL] message k=v ...
+#define DLOG_FORMAT_JSON   1   // {"time":"...","level":"INFO","logger":"...","msg":"...","k":v}
+#define DLOG_FORMAT_LOGFMT 2   // time=... level=info logger=... msg="..." k=v
+
+/**
+ * 编码行主体：text 为 "msg k=v ..."，json 为 "\"msg\":\"...\",\"k\":v"（不含花括号），logfmt 为 "msg=... k=v"。
+ * kvs 按键、值交替排列，键须为字符串。语义同 snprintf：最多写入 cap - 1 个字符并以 NUL 结尾，返回所需长度。
+ */
+int dlog_kv_render(char* out, size_t cap, int format, const char* msg, size_t msg_len,
+                   const struct dlog_value* kvs, int count);
+
+/* 编码调用点字段（pid、tid、file、func、line），以分隔符结尾，语义同 snprintf */
+int dlog_kv_site(char* out, size_t cap, int format, int pid, int tid, const char* file, const char* func, int line);
+
+/* 编码时间之后的等级和实例名字段：json 形如 "\",\"level\":\"INFO\",\"logger\":\"name\","，
+ * logfmt 形如 "\" level=info logger=name "（时间带引号输出），语义同 snprintf */
+int dlog_kv_level(char* out, size_t cap, int format, const char* level, const char* logger_name);
+
+#endif //DLOG_KV_H
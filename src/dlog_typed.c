@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dlog_typed.h"
+
+/* 单个数值转换的最大长度：64 位整数 20 位、定点小数的整数部分和小数位 */
+#define VALUE_BUFFER_SIZE 64
+/* 定点小数快速路径支持的最大小数位数，更多位数或数值过大时退回 snprintf */
+#define FAST_FLOAT_MAX_PRECISION 9
+#define FAST_FLOAT_LIMIT 1e18
+/* 放大后的小数部分（小于 1e9）的乘法误差不超过 1.2e-7，离 .5 在此范围内时无法确定舍入方向 */
+#define FAST_FLOAT_TIE_EPSILON 1e-6
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const double pow10_table[FAST_FLOAT_MAX_PRECISION + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+// 无符号整数转十进制，从 end 向前写，返回起始位置；每次处理两位
+static char* format_u64(char* end, unsigned long long value) {
+    char* p = end;
+    while (value >= 100) {
+        unsigned idx = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    }
+    if (value >= 10) {
+        unsigned idx = (unsigned)value * 2;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return p;
+}
+
+static char* format_hex(char* end, unsigned long long value) {
+    static const char hex_digits[] = "0123456789abcdef";
+    char* p = end;
+    do {
+        *--p = hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+    return p;
+}
+
+static inline int float_fast_path(double value, int precision) {
+    return precision <= FAST_FLOAT_MAX_PRECISION && value > -FAST_FLOAT_LIMIT && value < FAST_FLOAT_LIMIT;
+}
+
+// 定点小数：小数部分放大后舍入，结果与 printf 一致；需满足 float_fast_path。
+// 放大后的余数接近 .5 时（含 printf 按偶数舍入的精确 .5）返回 0，由调用方交给 snprintf
+static size_t format_float(char* buffer, double value, int precision) {
+    int negative = value < 0 || (value == 0 && __builtin_signbit(value));
+    double magnitude = negative ? -value : value;
+    double scale = pow10_table[precision];
+    unsigned long long integer = (unsigned long long)magnitude;
+    double scaled = (magnitude - (double)integer) * scale;
+    unsigned long long fraction = (unsigned long long)scaled;
+    double rem = scaled - (double)fraction;
+    if (rem > 0.5 - FAST_FLOAT_TIE_EPSILON && rem < 0.5 + FAST_FLOAT_TIE_EPSILON) return 0;
+    if (rem > 0.5) fraction++;
+    if (fraction >= (unsigned long long)scale) {
+        integer++;
+        fraction -= (unsigned long long)scale;
+    }
+
+    char digits[VALUE_BUFFER_SIZE];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    if (precision > 0) {
+        for (int i = 0; i < precision; i++) {
+            *--p = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        *--p = '.';
+    }
+    p = format_u64(p, integer);
+    if (negative) *--p = '-';
+    size_t len = (size_t)(end - p);
+    memcpy(buffer, p, len);
+    return len;
+}
+
+// 追加到输出：空间不足时截断，但继续累计所需长度
+static inline void append(char* out, size_t cap, size_t* total, const char* data, size_t len) {
+    if (*total + 1 < cap) {
+        size_t room = cap - *total - 1;
+        memcpy(out + *total, data, len < room ? len : room);
+    }
+    *total += len;
+}
+
+int dlog_typed_render(char* out, size_t cap, const struct dlog_value* values, int count) {
+    size_t total = 0;
+    char buffer[VALUE_BUFFER_SIZE];
+    char* end = buffer + sizeof(buffer);
+    for (int i = 0; i < count; i++) {
+        const struct dlog_value* value = &values[i];
+        switch (value->type) {
+            case DLOG_VALUE_STR: {
+                const char* s = value->v.s ? value->v.s : "(null)";
+                append(out, cap, &total, s, strlen(s));
+                break;
+            }
+            case DLOG_VALUE_INT: {
+                long long v = value->v.i;
+                char* p = format_u64(end, v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+                if (v < 0) *--p = '-';
+                append(out, cap, &total, p, (size_t)(end - p));
+                break;
+            }
+            case DLOG_VALUE_UINT: {
+                char* p = format_u64(end, value->v.u);
+                append(out, cap, &total, p, (size_t)(end - p));
+                break;
+            }
+            case DLOG_VALUE_HEX: {
+                char* p = format_hex(end, value->v.u);
+                append(out, cap, &total, p, (size_t)(end - p));
+                break;
+            }
+            case DLOG_VALUE_FLOAT: {
+                int precision = value->precision >= 0 ? value->precision : DLOG_FLOAT_PRECISION;
+                size_t fast_len = float_fast_path(value->v.f, precision) ? format_float(buffer, value->v.f, precision) : 0;
+                if (fast_len > 0) {
+                    append(out, cap, &total, buffer, fast_len);
+                    break;
+                }
+                // 非有限值、超出范围、位数过多或接近舍入边界时交给 snprintf，直接写到输出
+                int len = snprintf(total < cap ? out + total : NULL, total < cap ? cap - total : 0,
+                                   "%.*f", precision, value->v.f);
+                if (len > 0) total += (size_t)len;
+                break;
+            }
+            case DLOG_VALUE_CHAR: {
+                char c = (char)value->v.i;
+                append(out, cap, &total, &c, 1);
+                break;
+            }
+            case DLOG_VALUE_PTR: {
+                // 与 glibc 的 %p 一致：NULL 输出 (nil)
+                if (!value->v.p) {
+                    append(out, cap, &total, "(nil)", 5);
+                    break;
+                }
+                char* p = format_hex(end, (unsigned long long)(uintptr_t)value->v.p);
+                *--p = 'x';
+                *--p = '0';
+                append(out, cap, &total, p, (size_t)(end - p));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    if (cap > 0) {
+        out[total < cap ? total : cap - 1] = '\0';
+    }
+    return (int)total;
+}
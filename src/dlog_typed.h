@@ -0,0 +1,17 @@
+/**
+ * @brief: 类型化格式化：按 struct dlog_value 的类型直接转换，不解析格式串
+ */
+#ifndef DLOG_TYPED_H
+#define DLOG_TYPED_H
+
+#include <stddef.h>
+
+#include "../include/dlog.h"
+
+/**
+ * 依次转换 values 并拼接到 out，语义同 snprintf：
+ * 最多写入 cap - 1 个字符并以 NUL 结尾，返回完整输出所需的长度。
+ */
+int dlog_typed_render(char* out, size_t cap, const struct dlog_value* values, int count);
+
+#endif //DLOG_TYPED_H
@@ -0,0 +1,190 @@
+/**
+ * @brief: 二进制日志解码工具，将 OUTPUT_BINARY 日志还原为文本格式
+ * 用法：dlog_decode [-u] <binary log file>
+ *   -u  按 UTC 输出时间（默认本地时间）
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../include/dlog.h"
+#include "../src/dlog_fmt.h"
+
+#define TIME_FORMAT "%Y-%m-%d %H:%M:%S"
+#define MAX_MESSAGE_SIZE (64 * 1024)
+#define MAX_FORMAT_COUNT (1024 * 1024)  // 格式串 id 按出现顺序从 0 分配，超出视为损坏
+
+static const char* get_level_str(uint8_t level) {
+    switch(level) {
+        case LOG_ERROR: return "[ERRO]";
+        case LOG_WARN:  return "[WARN]";
+        case LOG_INFO:  return "[INFO]";
+        case LOG_DEBUG: return "[DEBG]";
+        case LOG_FATAL: return "[FTAL]";
+        default:        return "[NONE]";
+    }
+}
+
+/* 格式串 id -> 格式串 */
+static char** formats = NULL;
+static uint32_t format_capacity = 0;
+
+static int set_format(uint32_t id, char* format) {
+    if (id >= MAX_FORMAT_COUNT) return -1;
+    if (id >= format_capacity) {
+        uint32_t capacity = format_capacity ? format_capacity : 64;
+        while (capacity <= id) capacity *= 2;
+        char** grown = (char**)realloc(formats, sizeof(char*) * capacity);
+        if (!grown) return -1;
+        memset(grown + format_capacity, 0, sizeof(char*) * (capacity - format_capacity));
+        formats = grown;
+        format_capacity = capacity;
+    }
+    free(formats[id]);
+    formats[id] = format;
+    return 0;
+}
+
+static int read_exact(FILE* file, void* buffer, size_t size) {
+    return fread(buffer, 1, size, file) == size ? 0 : -1;
+}
+
+static void print_line(int64_t sec, uint32_t nsec, uint8_t level, const char* message, int utc) {
+    char time_str[32];
+    struct tm tm_info;
+    time_t t = (time_t)sec;
+    if (utc) {
+        gmtime_r(&t, &tm_info);
+    } else {
+        localtime_r(&t, &tm_info);
+    }
+    strftime(time_str, sizeof(time_str), TIME_FORMAT, &tm_info);
+    printf("%s.%03u %s %s\n", time_str, nsec / 1000000, get_level_str(level), message);
+}
+
+int main(int argc, char* argv[]) {
+    int utc = 0;
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-u") == 0) {
+            utc = 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s [-u] <binary log file>\n", argv[0]);
+        return 1;
+    }
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error opening file: %s\n", path);
+        return 1;
+    }
+    char magic[DLOG_BIN_MAGIC_LEN];
+    if (read_exact(file, magic, sizeof(magic)) != 0 || memcmp(magic, DLOG_BIN_MAGIC, DLOG_BIN_MAGIC_LEN) != 0) {
+        fprintf(stderr, "Not a dlog binary log: %s\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    char* payload = (char*)malloc(MAX_MESSAGE_SIZE);
+    char* message = (char*)malloc(MAX_MESSAGE_SIZE);
+    int ret = 0;
+    int tag;
+    if (!payload || !message) {
+        fprintf(stderr, "Out of memory\n");
+        ret = 1;
+    }
+    while (ret == 0 && (tag = fgetc(file)) != EOF) {
+        long offset = ftell(file) - 1;
+        char head[DLOG_BIN_ENTRY_HEAD_LEN];
+        head[0] = (char)tag;
+        if (tag == DLOG_BIN_FORMAT) {
+            uint32_t id, len;
+            if (read_exact(file, head + 1, DLOG_BIN_FORMAT_HEAD_LEN - 1) != 0) {
+                fprintf(stderr, "Truncated record at offset %ld\n", offset);
+                ret = 1;
+                break;
+            }
+            memcpy(&id, head + 1, 4);
+            memcpy(&len, head + 5, 4);
+            if (id >= MAX_FORMAT_COUNT || len >= MAX_MESSAGE_SIZE) {
+                fprintf(stderr, "Corrupt record (format id %u, length %u) at offset %ld\n", id, len, offset);
+                ret = 1;
+                break;
+            }
+            char* format = (char*)malloc((size_t)len + 1);
+            if (!format || read_exact(file, format, len) != 0) {
+                fprintf(stderr, "%s record at offset %ld\n", format ? "Truncated" : "Out of memory reading", offset);
+                free(format);
+                ret = 1;
+                break;
+            }
+            format[len] = '\0';
+            if (set_format(id, format) != 0) {
+                fprintf(stderr, "Out of memory reading record at offset %ld\n", offset);
+                free(format);
+                ret = 1;
+                break;
+            }
+            continue;
+        }
+
+        int is_entry = (tag == DLOG_BIN_ENTRY);
+        if (!is_entry && tag != DLOG_BIN_TEXT) {
+            fprintf(stderr, "Corrupt record (tag 0x%02x) at offset %ld\n", tag, offset);
+            ret = 1;
+            break;
+        }
+        size_t head_len = is_entry ? DLOG_BIN_ENTRY_HEAD_LEN : DLOG_BIN_TEXT_HEAD_LEN;
+        if (read_exact(file, head + 1, head_len - 1) != 0) {
+            fprintf(stderr, "Truncated record at offset %ld\n", offset);
+            ret = 1;
+            break;
+        }
+        uint8_t level = (uint8_t)head[1];
+        int64_t sec;
+        uint32_t nsec, len, id = 0;
+        memcpy(&sec, head + 2, 8);
+        memcpy(&nsec, head + 10, 4);
+        if (is_entry) {
+            memcpy(&id, head + 14, 4);
+            memcpy(&len, head + 18, 4);
+        } else {
+            memcpy(&len, head + 14, 4);
+        }
+        if (len >= MAX_MESSAGE_SIZE) {
+            fprintf(stderr, "Corrupt record (length %u) at offset %ld\n", len, offset);
+            ret = 1;
+            break;
+        }
+        if (read_exact(file, payload, len) != 0) {
+            fprintf(stderr, "Truncated record at offset %ld\n", offset);
+            ret = 1;
+            break;
+        }
+        payload[len] = '\0';
+
+        if (!is_entry) {
+            print_line(sec, nsec, level, payload, utc);
+        } else if (id >= format_capacity || !formats[id]) {
+            print_line(sec, nsec, level, "[UNKNOWN FORMAT]", utc);
+        } else if (dlog_fmt_render(message, MAX_MESSAGE_SIZE, formats[id], payload, len) < 0) {
+            print_line(sec, nsec, level, "[LOG FORMAT ERROR]", utc);
+        } else {
+            print_line(sec, nsec, level, message, utc);
+        }
+    }
+
+    for (uint32_t i = 0; i < format_capacity; i++) {
+        free(formats[i]);
+    }
+    free(formats);
+    free(payload);
+    free(message);
+    fclose(file);
+    return ret;
+}